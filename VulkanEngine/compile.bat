@@ -1,9 +1,17 @@
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\point_light.vert -o shaders\point_light.vert.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\point_light.frag -o shaders\point_light.frag.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\shader.vert -o shaders\vertex.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\shader.frag -o shaders\fragment.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\sky_shader.vert -o shaders\sky_vertex.spv
-C:\VulkanSDK\1.3.243.0\Bin\glslc.exe shaders\sky_shader.frag -o shaders\sky_fragment.spv
+@echo off
+rem Same shaders as the CustomBuild items in VulkanEngine.vcxproj, for rebuilding them outside Visual Studio
+set GLSLC=%VULKAN_SDK%\Bin\glslc.exe
+if "%VULKAN_SDK%"=="" set GLSLC=C:\VulkanSDK\1.3.243.0\Bin\glslc.exe
+
+"%GLSLC%" shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
+"%GLSLC%" shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
+"%GLSLC%" shaders\point_light.vert -o shaders\point_light.vert.spv
+"%GLSLC%" shaders\point_light.frag -o shaders\point_light.frag.spv
+"%GLSLC%" shaders\shader.vert -o shaders\vertex.spv
+"%GLSLC%" shaders\shader.frag -o shaders\fragment.spv
+"%GLSLC%" shaders\sky_shader.vert -o shaders\sky_vertex.spv
+"%GLSLC%" shaders\sky_shader.frag -o shaders\sky_fragment.spv
+"%GLSLC%" shaders\cull.comp -o shaders\cull_compute.spv
+"%GLSLC%" shaders\scatter.comp -o shaders\scatter_compute.spv
+"%GLSLC%" shaders\expand.comp -o shaders\expand_compute.spv
 pause
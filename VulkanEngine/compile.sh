@@ -0,0 +1,19 @@
+#!/bin/sh
+# Same shaders as compile.bat and the CustomBuild items in VulkanEngine.vcxproj.
+# Uses glslc from $VULKAN_SDK/bin when set, otherwise from PATH.
+set -e
+cd "$(dirname "$0")"
+
+GLSLC="${VULKAN_SDK:+$VULKAN_SDK/bin/}glslc"
+
+"$GLSLC" shaders/simple_shader.vert -o shaders/simple_shader.vert.spv
+"$GLSLC" shaders/simple_shader.frag -o shaders/simple_shader.frag.spv
+"$GLSLC" shaders/point_light.vert -o shaders/point_light.vert.spv
+"$GLSLC" shaders/point_light.frag -o shaders/point_light.frag.spv
+"$GLSLC" shaders/shader.vert -o shaders/vertex.spv
+"$GLSLC" shaders/shader.frag -o shaders/fragment.spv
+"$GLSLC" shaders/sky_shader.vert -o shaders/sky_vertex.spv
+"$GLSLC" shaders/sky_shader.frag -o shaders/sky_fragment.spv
+"$GLSLC" shaders/cull.comp -o shaders/cull_compute.spv
+"$GLSLC" shaders/scatter.comp -o shaders/scatter_compute.spv
+"$GLSLC" shaders/expand.comp -o shaders/expand_compute.spv
@@ -3,18 +3,44 @@
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 layout(location = 2) in vec3 fragNormal;
+layout(location = 3) flat in uint fragMaterial;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D material;
+// One material per mesh type, sized with MeshTypeCount, see ShaderConstants
+layout(constant_id = 22) const uint materialCount = 4;
+layout(set = 1, binding = 0) uniform sampler2D materials[materialCount];
 
-const vec4 sunColor = vec4(1.0, 1.0, 1.0, 1.0);
-const vec3 sunDirection = normalize(vec3(1.0, 1.0, -1.0));
+// Feature toggles, see ShaderFeatures. Disabled features are compiled out of the variant.
+layout(constant_id = 0) const bool sunLight = true;
+layout(constant_id = 1) const bool albedoTexture = true;
+layout(constant_id = 2) const bool vertexColor = true;
+
+// Lighting, see ShaderConstants
+layout(constant_id = 16) const float sunColorR = 1.0;
+layout(constant_id = 17) const float sunColorG = 1.0;
+layout(constant_id = 18) const float sunColorB = 1.0;
+layout(constant_id = 19) const float sunDirectionX = 1.0;
+layout(constant_id = 20) const float sunDirectionY = 1.0;
+layout(constant_id = 21) const float sunDirectionZ = -1.0;
 
 void main() 
 {
-	outColor = sunColor * max(0.0, dot(fragNormal, -sunDirection)) * vec4(fragColor, 1.0) * texture(material, fragTexCoord);
-	//outColor = vec4(fragColor, 1.0) * texture(material, fragTexCoord);
+	outColor = vec4(1.0);
+	if (sunLight)
+	{
+		vec4 sunColor = vec4(sunColorR, sunColorG, sunColorB, 1.0);
+		vec3 sunDirection = normalize(vec3(sunDirectionX, sunDirectionY, sunDirectionZ));
+		outColor *= sunColor * max(0.0, dot(fragNormal, -sunDirection));
+	}
+	if (vertexColor)
+	{
+		outColor *= vec4(fragColor, 1.0);
+	}
+	if (albedoTexture)
+	{
+		outColor *= texture(materials[fragMaterial], fragTexCoord);
+	}
 	//TODO: Quick hack to discard transparent pixels, won't work for semi transparent i think
 	//if (outColor.w < 0.8)
 	//{
@@ -15,6 +15,24 @@ layout(std140, set = 0, binding = 1) readonly buffer storageBuffer
 	mat4 model[];
 } ObjectData;
 
+// Indices into ObjectData of the instances which survived culling, packed per draw
+layout(std430, set = 0, binding = 2) readonly buffer visibleBuffer
+{
+	uint index[];
+} VisibleInstances;
+
+// Mesh type of every instance
+layout(std430, set = 0, binding = 3) readonly buffer meshIndexBuffer
+{
+	uint mesh[];
+} InstanceMeshes;
+
+// Material slot of every mesh type
+layout(std430, set = 1, binding = 1) readonly buffer drawDataBuffer
+{
+	uint material[];
+} DrawData;
+
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexColor;
 layout(location = 2) in vec2 vertexTexCoord;
@@ -23,11 +41,18 @@ layout(location = 3) in vec3 vertexNormal;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragNormal;
+layout(location = 3) flat out uint fragMaterial;
 
 void main() 
 {
-	gl_Position = cameraData.viewProjection * ObjectData.model[gl_InstanceIndex] * vec4(vertexPosition, 1.0);
+	uint instance = VisibleInstances.index[gl_InstanceIndex];
+	mat4 model = ObjectData.model[instance];
+	gl_Position = cameraData.viewProjection * model * vec4(vertexPosition, 1.0);
 	fragColor = vertexColor;
 	fragTexCoord = vertexTexCoord;
-	fragNormal = normalize((ObjectData.model[gl_InstanceIndex] * vec4(vertexNormal, 0.0)).xyz);
+	// model is translate * rotate * scale, dividing by the squared axis scales
+	// turns it into the inverse transpose for normals
+	vec3 scaleSquared = vec3(dot(model[0].xyz, model[0].xyz), dot(model[1].xyz, model[1].xyz), dot(model[2].xyz, model[2].xyz));
+	fragNormal = normalize(mat3(model) * (vertexNormal / scaleSquared));
+	fragMaterial = DrawData.material[InstanceMeshes.mesh[instance]];
 }
\ No newline at end of file
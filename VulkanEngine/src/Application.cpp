@@ -1,16 +1,21 @@
 #include "Application.h"
+#include "Memory.h"
 
-Application::Application(int width, int height) 
+Application::Application(int width, int height, bool headless, bool gpuCulling) 
+	: m_width{ width },
+	m_height{ height }
 {
-	BuildGlfwWindow(width, height);
+	if (!headless)
+		BuildGlfwWindow(width, height);
 
-	m_graphicsEngine = new Engine(width, height, m_window);
+	m_graphicsEngine = new Engine(width, height, m_window, gpuCulling);
 
 	m_scene = new Scene();
 }
 
 Application::~Application() 
 {
+	delete m_recorder;
 	delete m_graphicsEngine;
 	delete m_scene;
 }
@@ -38,11 +43,192 @@ void Application::Run()
 	while (!glfwWindowShouldClose(m_window))
 	{
 		glfwPollEvents();
-		m_graphicsEngine->Render(m_scene);
+		RenderFrame();
 		CalculateFrameRate();
 	}
 }
 
+void Application::RunFrames(uint32_t frameCount, const char* filename)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		if (m_window)
+			glfwPollEvents();
+		RenderFrame();
+	}
+
+	WriteFrame(filename);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	PrintThroughput(frameCount, seconds);
+}
+
+void Application::StartCapture(const std::string& filename)
+{
+	delete m_recorder;
+	m_recorder = new SceneRecorder(filename);
+}
+
+void Application::Replay(const std::string& filename)
+{
+	SceneReplay replay(filename);
+
+	//Uncapped, and without waiting on vblank where tearing is allowed
+	m_graphicsEngine->SetFrameRateCap(0.0);
+	const std::vector<vk::PresentModeKHR>& presentModes = m_graphicsEngine->GetSupportedPresentModes();
+	if (std::find(presentModes.begin(), presentModes.end(), vk::PresentModeKHR::eImmediate) != presentModes.end())
+		m_graphicsEngine->SetPresentMode(vk::PresentModeKHR::eImmediate);
+
+	auto start = std::chrono::steady_clock::now();
+	uint32_t frameCount = 0;
+	int width, height;
+
+	while (replay.NextFrame(*m_scene, width, height))
+	{
+		//Offscreen targets keep their size, only a window follows the recorded size
+		if (m_window)
+		{
+			glfwPollEvents();
+			if (glfwWindowShouldClose(m_window))
+				break;
+
+			int windowWidth, windowHeight;
+			glfwGetFramebufferSize(m_window, &windowWidth, &windowHeight);
+			if (width > 0 && height > 0 && (width != windowWidth || height != windowHeight))
+				glfwSetWindowSize(m_window, width, height);
+		}
+
+		RenderFrame();
+		++frameCount;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	PrintThroughput(frameCount, seconds);
+}
+
+void Application::RenderFrame()
+{
+	if (m_recorder)
+	{
+		int width = m_width, height = m_height;
+		if (m_window)
+			glfwGetFramebufferSize(m_window, &width, &height);
+		m_recorder->CaptureFrame(*m_scene, width, height);
+	}
+
+	m_graphicsEngine->Render(m_scene);
+}
+
+void Application::PrintThroughput(uint32_t frameCount, double seconds) const
+{
+	std::cout << "Rendered " << frameCount << " frames in " << std::fixed << std::setprecision(3) << seconds << " s, "
+		<< std::setprecision(1) << frameCount / std::max(seconds, 1e-9) << " fps" << std::endl;
+
+	vkUtil::FrameStatsSummary summary = m_graphicsEngine->GetFrameStats().Summarize(frameCount);
+	std::cout << "Frame time p50 " << std::setprecision(2) << summary.m_frame.m_p50 << " ms, p95 " << summary.m_frame.m_p95
+		<< " ms, p99 " << summary.m_frame.m_p99 << " ms, max " << summary.m_frame.m_max << " ms, "
+		<< summary.m_hitchCount << " hitches" << std::endl;
+}
+
+void Application::RunBenchmark(const BenchmarkSettings& settings)
+{
+	float halfExtent = PopulateStressScene(*m_scene, settings);
+	uint32_t totalFrames = settings.m_warmupFrames + settings.m_frameCount;
+
+	std::chrono::steady_clock::time_point start;
+	vkUtil::RenderStats renderStats;
+	uint32_t measuredFrames = 0;
+	for (uint32_t frame = 0; frame < totalFrames; ++frame)
+	{
+		//Warmup frames already fly the path's start, so the first measured frame isn't a cold one
+		uint32_t measuredFrame = (frame < settings.m_warmupFrames) ? 0 : frame - settings.m_warmupFrames;
+		if (frame == settings.m_warmupFrames)
+			start = std::chrono::steady_clock::now();
+
+		SetBenchmarkCamera(*m_scene, halfExtent, measuredFrame, settings.m_frameCount);
+
+		if (m_window)
+		{
+			glfwPollEvents();
+			if (glfwWindowShouldClose(m_window))
+				break;
+		}
+		RenderFrame();
+
+		if (frame >= settings.m_warmupFrames)
+		{
+			renderStats += m_graphicsEngine->GetRenderStats();
+			++measuredFrames;
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	vkUtil::FrameStatsSummary summary = m_graphicsEngine->GetFrameStats().Summarize(settings.m_frameCount);
+
+	std::ofstream file(settings.m_summaryFilename);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write \"" << settings.m_summaryFilename << "\"" << std::endl;
+		return;
+	}
+
+	file << "{\n\"layout\":\"" << GetSceneLayoutName(settings.m_layout) << "\""
+		<< ",\n\"instances_per_mesh\":" << settings.m_instancesPerMesh
+		<< ",\n\"instances\":" << m_scene->GetInstanceCount()
+		<< ",\n\"seed\":" << settings.m_seed
+		<< ",\n\"headless\":" << (m_graphicsEngine->IsHeadless() ? "true" : "false")
+		<< ",\n\"warmup_frames\":" << settings.m_warmupFrames
+		<< ",\n\"seconds\":" << seconds
+		<< ",\n\"fps\":" << summary.m_frameCount / std::max(seconds, 1e-9)
+		<< ",\n\"frame_stats\":";
+	vkUtil::WriteSummaryJson(file, summary);
+	file << ",\n\"render_stats_per_frame\":";
+	vkUtil::WriteRenderStatsJson(file, renderStats, 1.0 / std::max(measuredFrames, 1u));
+	file << ",\n\"device_memory_bytes\":" << vkUtil::GetAllocatedMemory()
+		<< ",\n\"peak_device_memory_bytes\":" << vkUtil::GetPeakAllocatedMemory()
+		<< "\n}\n";
+
+	std::cout << "Benchmark: " << m_scene->GetInstanceCount() << " instances, " << GetSceneLayoutName(settings.m_layout)
+		<< " layout, p50 " << std::fixed << std::setprecision(2) << summary.m_frame.m_p50 << " ms, p99 " << summary.m_frame.m_p99
+		<< " ms, summary written to " << settings.m_summaryFilename << std::endl;
+}
+
+void Application::SaveFrameStats(const std::string& filename) const
+{
+	const vkUtil::FrameStats& frameStats = m_graphicsEngine->GetFrameStats();
+
+	bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+	if (json)
+		frameStats.WriteJson(filename.c_str());
+	else
+		frameStats.WriteCsv(filename.c_str());
+}
+
+void Application::WriteFrame(const char* filename)
+{
+	if (!m_graphicsEngine->IsHeadless())
+		return;
+
+	std::vector<uint8_t> pixels = m_graphicsEngine->ReadBackFrame();
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write \"" << filename << "\"" << std::endl;
+		return;
+	}
+
+	//Binary PPM, RGB without alpha
+	file << "P6\n" << m_width << " " << m_height << "\n255\n";
+	for (size_t pixel = 0; pixel + 3 < pixels.size(); pixel += 4)
+	{
+		char rgb[3] = { static_cast<char>(pixels[pixel + 2]), static_cast<char>(pixels[pixel + 1]), static_cast<char>(pixels[pixel]) };
+		file.write(rgb, 3);
+	}
+}
+
 void Application::CalculateFrameRate() 
 {
 	m_currentTime = glfwGetTime();
@@ -51,8 +237,12 @@ void Application::CalculateFrameRate()
 	if (deltaTime >= 1) 
 	{
 		int framerate{ std::max(1, int(m_numFrames / deltaTime)) };
+		//Percentiles over the frames of the last second, the average hides hitches
+		vkUtil::FrameStatsSummary summary = m_graphicsEngine->GetFrameStats().Summarize(static_cast<uint32_t>(std::max(m_numFrames, 1)));
 		std::stringstream title;
-		title << "Running at " << framerate << " fps.";
+		title << "Running at " << framerate << " fps, "
+			<< std::fixed << std::setprecision(1) << "p99 " << summary.m_presentInterval.m_p99 << " ms, "
+			<< m_graphicsEngine->GetFramePacer().GetAverageLatency() << " ms input latency.";
 		glfwSetWindowTitle(m_window, title.str().c_str());
 		m_lastTime = m_currentTime;
 		m_numFrames = -1;
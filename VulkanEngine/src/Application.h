@@ -2,18 +2,66 @@
 #include "Config.h"
 #include "Engine.h"
 #include "Scene.h"
+#include "Benchmark.h"
+#include "SceneCapture.h"
 
 class Application 
 {
 public:
-	Application(int width, int height);
+	/**
+		\param width the width of the window, or of the offscreen images
+		\param height the height of the window, or of the offscreen images
+		\param headless whether to render offscreen, without a window
+		\param gpuCulling whether to cull in a compute pass, or on the CPU
+	*/
+	Application(int width, int height, bool headless, bool gpuCulling);
 	~Application();
 	void Run();
 
+	/**
+		Render a fixed number of frames, then save the last one and report throughput.
+		Meant for headless runs, where there is no window to close.
+
+		\param frameCount the number of frames to render
+		\param filename the binary PPM image to write the final frame to
+	*/
+	void RunFrames(uint32_t frameCount, const char* filename);
+
+	/**
+		Replace the scene with a procedural stress scene, fly the scripted camera path through it
+		and write a JSON summary of frame times and memory use.
+
+		\param settings the scene, frame counts and output file
+	*/
+	void RunBenchmark(const BenchmarkSettings& settings);
+
+	/**
+		Record every following frame's scene changes, camera and size into a capture file.
+
+		\param filename the capture file to create
+	*/
+	void StartCapture(const std::string& filename);
+
+	/**
+		Play a capture back frame for frame as fast as possible, then report throughput.
+
+		\param filename the capture file to play
+	*/
+	void Replay(const std::string& filename);
+
+	/**
+		Save the timings of recent frames, as CSV or as JSON with a percentile summary.
+
+		\param filename the file to write, JSON if it ends in .json, CSV otherwise
+	*/
+	void SaveFrameStats(const std::string& filename) const;
+
 private:
 	Engine*		m_graphicsEngine;
-	GLFWwindow*	m_window;
+	GLFWwindow*	m_window{ nullptr };
 	Scene*		m_scene;
+	SceneRecorder*	m_recorder{ nullptr };
+	int		m_width, m_height;
 
 	double	m_lastTime, m_currentTime;
 	int		m_numFrames;
@@ -21,4 +69,7 @@ private:
 
 	void BuildGlfwWindow(int width, int height);
 	void CalculateFrameRate();
+	void WriteFrame(const char* filename);
+	void RenderFrame();
+	void PrintThroughput(uint32_t frameCount, double seconds) const;
 };
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "Benchmark.h"
+
+namespace
+{
+	//Distance between neighbouring instances of the grid, and the density of the other layouts
+	constexpr float instanceSpacing = 3.0f;
+
+	//Average number of instances per cluster in the clustered layout
+	constexpr uint32_t clusterSize = 256;
+
+	constexpr float pi = 3.14159265f;
+}
+
+std::optional<SceneLayout> ParseSceneLayout(const std::string& name)
+{
+	if (name == "grid")
+		return SceneLayout::GRID;
+	if (name == "random")
+		return SceneLayout::RANDOM;
+	if (name == "clustered")
+		return SceneLayout::CLUSTERED;
+	return std::nullopt;
+}
+
+const char* GetSceneLayoutName(SceneLayout layout)
+{
+	switch (layout)
+	{
+	case SceneLayout::RANDOM:
+		return "random";
+	case SceneLayout::CLUSTERED:
+		return "clustered";
+	default:
+		return "grid";
+	}
+}
+
+float PopulateStressScene(Scene& scene, const BenchmarkSettings& settings)
+{
+	scene.Clear();
+
+	//Every layout covers the same square, so layouts differ only in distribution
+	uint32_t instanceCount = settings.m_instancesPerMesh * MeshTypeCount;
+	uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount)))));
+	float halfExtent = 0.5f * instanceSpacing * side;
+
+	std::mt19937 random(settings.m_seed);
+	std::uniform_real_distribution<float> anywhere(-halfExtent, halfExtent);
+
+	std::vector<glm::vec2> clusterCenters(std::max(1u, instanceCount / clusterSize));
+	for (glm::vec2& center : clusterCenters)
+	{
+		center = glm::vec2(0.8f * anywhere(random), 0.8f * anywhere(random));
+	}
+	std::normal_distribution<float> aroundCluster(0.0f, 4.0f * instanceSpacing);
+
+	//Mesh types are interleaved, so every region of the scene mixes all of them
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		glm::vec2 position;
+		switch (settings.m_layout)
+		{
+		case SceneLayout::RANDOM:
+			position = glm::vec2(anywhere(random), anywhere(random));
+			break;
+		case SceneLayout::CLUSTERED:
+			position = clusterCenters[i % clusterCenters.size()] + glm::vec2(aroundCluster(random), aroundCluster(random));
+			break;
+		default:
+			position = glm::vec2((i % side + 0.5f) * instanceSpacing - halfExtent, (i / side + 0.5f) * instanceSpacing - halfExtent);
+			break;
+		}
+
+		scene.AddInstance(static_cast<MeshTypes>(i % MeshTypeCount), glm::vec3(position, 0.0f));
+	}
+
+	return halfExtent;
+}
+
+void SetBenchmarkCamera(Scene& scene, float halfExtent, uint32_t frame, uint32_t frameCount)
+{
+	//Fly a circle halfway out, looking ahead along it and slightly down into the instances
+	float radius = 0.5f * halfExtent;
+	float height = 5.0f + 0.05f * halfExtent;
+	float angle = 2.0f * pi * frame / std::max(frameCount, 1u);
+	float lookAhead = 0.3f;
+
+	glm::vec3 eye(radius * std::cos(angle), radius * std::sin(angle), height);
+	glm::vec3 target(radius * std::cos(angle + lookAhead), radius * std::sin(angle + lookAhead), 0.0f);
+	scene.SetCamera(eye, target);
+}
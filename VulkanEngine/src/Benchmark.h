@@ -0,0 +1,54 @@
+#pragma once
+#include "Config.h"
+#include "Scene.h"
+
+/**
+	How a stress scene spreads its instances over the ground plane.
+*/
+enum class SceneLayout
+{
+	GRID,
+	RANDOM,
+	CLUSTERED
+};
+
+/**
+	\param name "grid", "random" or "clustered"
+	\returns the layout, or nothing for an unknown name
+*/
+std::optional<SceneLayout> ParseSceneLayout(const std::string& name);
+
+const char* GetSceneLayoutName(SceneLayout layout);
+
+struct BenchmarkSettings
+{
+	SceneLayout m_layout{ SceneLayout::GRID };
+	uint32_t m_instancesPerMesh{ 1000 };
+	// Frames rendered before measuring, so buffers have grown and caches are warm
+	uint32_t m_warmupFrames{ 60 };
+	// Measured frames, percentiles cover at most the frame stats ring (4096 frames)
+	uint32_t m_frameCount{ 1000 };
+	uint32_t m_seed{ 1 };
+	std::string m_summaryFilename{ "benchmark.json" };
+};
+
+/**
+	Replace the scene's instances with a procedural stress scene,
+	the same for the same settings on every run.
+
+	\param scene the scene to fill
+	\param settings layout, instance count and seed
+	\returns the half extent of the square the instances cover, centered on the origin
+*/
+float PopulateStressScene(Scene& scene, const BenchmarkSettings& settings);
+
+/**
+	Place the camera along the scripted benchmark path, a circling flight over the instances.
+	Driven by the frame index instead of time, so every run sees the same views.
+
+	\param scene the scene whose camera to move
+	\param halfExtent the half extent of the stress scene
+	\param frame the index of the measured frame
+	\param frameCount the number of measured frames, one full circle
+*/
+void SetBenchmarkCamera(Scene& scene, float halfExtent, uint32_t frame, uint32_t frameCount);
@@ -115,4 +115,53 @@ namespace vkInit
 			}
 		}
 	}
+
+	/**
+		Make sure a frame has enough command pools and secondary command buffers for
+		recording on worker threads, one pair per worker so no pool is shared between threads.
+		Existing pairs are kept, only missing ones are made.
+		\param device the logical device
+		\param physicalDevice the physical device
+		\param surface the windows surface (used for getting the queue families)
+		\param frame the swapchain frame to fill
+		\param workerCount the number of threads recording at once
+		\param debug whether the system is running in debug mode
+	*/
+	void CreateFrameWorkerCommandBuffers(vk::Device device, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface,
+		vkUtil::SwapChainFrame& frame, uint32_t workerCount, bool debug)
+	{
+		uint32_t existingCount = static_cast<uint32_t>(frame.workerCommandPools.size());
+		if (workerCount <= existingCount)
+			return;
+
+		frame.workerCommandPools.resize(workerCount);
+		frame.workerCommandBuffers.resize(workerCount);
+
+		for (uint32_t worker = existingCount; worker < workerCount; ++worker)
+		{
+			frame.workerCommandPools[worker] = CreateCommandPool(device, physicalDevice, surface, debug);
+
+			vk::CommandBufferAllocateInfo allocInfo = {};
+			allocInfo.commandPool = frame.workerCommandPools[worker];
+			allocInfo.level = vk::CommandBufferLevel::eSecondary;
+			allocInfo.commandBufferCount = 1;
+
+			try
+			{
+				frame.workerCommandBuffers[worker] = device.allocateCommandBuffers(allocInfo)[0];
+			}
+			catch (vk::SystemError err)
+			{
+				if (debug)
+				{
+					std::cout << "Failed to allocate worker command buffer " << worker << std::endl;
+				}
+			}
+		}
+
+		if (debug)
+		{
+			std::cout << "Allocated " << workerCount - existingCount << " worker command buffers" << std::endl;
+		}
+	}
 }
\ No newline at end of file
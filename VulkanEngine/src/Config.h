@@ -27,11 +27,28 @@
 #include <optional>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <unordered_map>
+#include <deque>
 #include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <future>
+#include <cstring>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <array>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 struct BufferInputChunk
@@ -58,10 +75,35 @@ enum class MeshTypes
 	ROOM
 };
 
+// Mesh types double as indices into per mesh arrays (bounds, draws, materials)
+constexpr uint32_t MeshTypeCount = static_cast<uint32_t>(MeshTypes::ROOM) + 1;
+
 enum class PipelineTypes
 {
 	SKY,
-	STANDARD
+	STANDARD,
+	// STANDARD without lighting or texturing, quick to compile and drawn while STANDARD compiles
+	STANDARD_FLAT
 };
 
+// Feature toggles a shader variant is compiled with, bit n drives specialization constant n.
+// Disabled features are resolved when the pipeline compiles, not branched on per fragment.
+namespace ShaderFeatures
+{
+	constexpr uint32_t SunLight = 1u << 0;
+	constexpr uint32_t AlbedoTexture = 1u << 1;
+	constexpr uint32_t VertexColor = 1u << 2;
+
+	constexpr uint32_t Count = 3;
+	constexpr uint32_t All = (1u << Count) - 1;
+}
+
+// Specialization constant ids of the lighting parameters and array sizes, after the feature toggles
+namespace ShaderConstants
+{
+	constexpr uint32_t SunColor = 16;		// r, g, b
+	constexpr uint32_t SunDirection = 19;	// x, y, z
+	constexpr uint32_t MaterialCount = 22;	// MeshTypeCount
+}
+
 std::vector<std::string> Split(std::string line, std::string delimiter);
\ No newline at end of file
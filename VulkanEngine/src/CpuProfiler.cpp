@@ -0,0 +1,103 @@
+#include "CpuProfiler.h"
+
+vkUtil::CpuProfiler& vkUtil::CpuProfiler::Get()
+{
+	static CpuProfiler profiler;
+	return profiler;
+}
+
+void vkUtil::CpuProfiler::SetEnabled(bool enabled)
+{
+	m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void vkUtil::CpuProfiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(buffer.m_mutex);
+	buffer.m_threadName = name;
+}
+
+void vkUtil::CpuProfiler::Record(const char* name, Clock::time_point start, Clock::time_point end)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	Event event;
+	event.m_name = name;
+	event.m_startUs = std::chrono::duration_cast<std::chrono::microseconds>(start - m_origin).count();
+	event.m_durationUs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+	std::lock_guard<std::mutex> lock(buffer.m_mutex);
+	if (buffer.m_events.size() < m_maxEventsPerThread)
+		buffer.m_events.push_back(event);
+}
+
+void vkUtil::CpuProfiler::Clear()
+{
+	std::lock_guard<std::mutex> buffersLock(m_buffersMutex);
+	for (const std::shared_ptr<ThreadBuffer>& buffer : m_buffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->m_mutex);
+		buffer->m_events.clear();
+	}
+}
+
+bool vkUtil::CpuProfiler::WriteChromeTrace(const char* filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write \"" << filename << "\"" << std::endl;
+		return false;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	auto separate = [&file, &first]()
+	{
+		if (!first)
+			file << ",";
+		file << "\n";
+		first = false;
+	};
+
+	std::lock_guard<std::mutex> buffersLock(m_buffersMutex);
+	for (const std::shared_ptr<ThreadBuffer>& buffer : m_buffers)
+	{
+		std::lock_guard<std::mutex> lock(buffer->m_mutex);
+
+		if (buffer->m_threadName)
+		{
+			separate();
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->m_threadId
+				<< ",\"args\":{\"name\":\"" << buffer->m_threadName << "\"}}";
+		}
+
+		//Zone names are literals from the engine, nothing needs escaping
+		for (const Event& event : buffer->m_events)
+		{
+			separate();
+			file << "{\"name\":\"" << event.m_name << "\",\"ph\":\"X\",\"ts\":" << event.m_startUs
+				<< ",\"dur\":" << event.m_durationUs << ",\"pid\":1,\"tid\":" << buffer->m_threadId << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	return true;
+}
+
+vkUtil::CpuProfiler::ThreadBuffer& vkUtil::CpuProfiler::GetThreadBuffer()
+{
+	//Registered on a thread's first zone, so threads which never record cost nothing
+	thread_local std::shared_ptr<ThreadBuffer> threadBuffer;
+	if (!threadBuffer)
+	{
+		threadBuffer = std::make_shared<ThreadBuffer>();
+
+		std::lock_guard<std::mutex> lock(m_buffersMutex);
+		threadBuffer->m_threadId = static_cast<uint32_t>(m_buffers.size());
+		m_buffers.push_back(threadBuffer);
+	}
+	return *threadBuffer;
+}
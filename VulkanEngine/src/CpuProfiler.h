@@ -0,0 +1,120 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	/**
+		Collects timed CPU zones from every thread and exports them as a Chrome trace
+		(chrome://tracing or ui.perfetto.dev).
+		Disabled by default, in which case a zone costs one relaxed atomic load.
+	*/
+	class CpuProfiler
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/**
+			\returns the process wide profiler
+		*/
+		static CpuProfiler& Get();
+
+		void SetEnabled(bool enabled);
+
+		bool IsEnabled() const
+		{
+			return m_enabled.load(std::memory_order_relaxed);
+		}
+
+		/**
+			Name the calling thread in the exported trace.
+
+			\param name must outlive the profiler, typically a string literal
+		*/
+		void SetThreadName(const char* name);
+
+		/**
+			Record a finished zone on the calling thread.
+
+			\param name must outlive the profiler, typically a string literal
+			\param start when the zone began
+			\param end when the zone ended
+		*/
+		void Record(const char* name, Clock::time_point start, Clock::time_point end);
+
+		/**
+			Drop every recorded zone.
+		*/
+		void Clear();
+
+		/**
+			Write all recorded zones in the Chrome trace event format.
+
+			\param filename the json file to write
+			\returns whether the file could be written
+		*/
+		bool WriteChromeTrace(const char* filename) const;
+
+	private:
+		struct Event
+		{
+			const char* m_name;
+			int64_t m_startUs;
+			int64_t m_durationUs;
+		};
+
+		// Each thread appends to its own buffer, the lock is only ever contended by an export
+		struct ThreadBuffer
+		{
+			std::mutex m_mutex;
+			uint32_t m_threadId{ 0 };
+			const char* m_threadName{ nullptr };
+			std::vector<Event> m_events;
+		};
+
+		// Caps memory use if profiling is left on, per thread
+		static constexpr size_t m_maxEventsPerThread{ 1 << 20 };
+
+		std::atomic<bool> m_enabled{ false };
+		const Clock::time_point m_origin{ Clock::now() };
+
+		// Buffers outlive their threads so zones from finished threads still export
+		mutable std::mutex m_buffersMutex;
+		std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+
+		CpuProfiler() = default;
+
+		ThreadBuffer& GetThreadBuffer();
+	};
+
+	/**
+		Times its own lifetime as a zone on the calling thread.
+	*/
+	class CpuZone
+	{
+	public:
+		/**
+			\param name must outlive the profiler, typically a string literal
+		*/
+		explicit CpuZone(const char* name)
+			: m_name{ name },
+			m_active{ CpuProfiler::Get().IsEnabled() }
+		{
+			if (m_active)
+				m_start = CpuProfiler::Clock::now();
+		}
+
+		~CpuZone()
+		{
+			if (m_active)
+				CpuProfiler::Get().Record(m_name, m_start, CpuProfiler::Clock::now());
+		}
+
+		CpuZone(const CpuZone&) = delete;
+		CpuZone& operator=(const CpuZone&) = delete;
+
+	private:
+		const char* m_name;
+		bool m_active;
+		CpuProfiler::Clock::time_point m_start;
+	};
+}
@@ -3,6 +3,7 @@
 #include "Memory.h"
 #include "Logging.h"
 #include "Descriptors.h"
+#include "CpuProfiler.h"
 
 vkImage::CubeMap::CubeMap(TextureInputChunk input) :
 	m_logicalDevice{ input.m_logicalDevice },
@@ -10,9 +11,12 @@ vkImage::CubeMap::CubeMap(TextureInputChunk input) :
 	m_filenames{ input.m_filenames },
 	m_commandBuffer{ input.m_commandBuffer },
 	m_queue{ input.m_queue },
+	m_uploadMutex{ input.m_uploadMutex },
 	m_layout{ input.m_layout },
 	m_descriptorPool{ input.m_descriptorPool }
 {
+	vkUtil::CpuZone zone("Load cube map");
+
 	Load();
 
 	ImageInputChunk imageInput;
@@ -30,6 +34,11 @@ vkImage::CubeMap::CubeMap(TextureInputChunk input) :
 	m_image = CreateImage(imageInput);
 	m_imageMemory = CreateImageMemory(imageInput, m_image);
 
+	//Decoding above runs in parallel, but the command buffer, queue and descriptor pool may be shared
+	std::unique_lock<std::mutex> uploadLock;
+	if (m_uploadMutex)
+		uploadLock = std::unique_lock<std::mutex>(*m_uploadMutex);
+
 	Populate();
 
 	for (int i = 0; i < 6; ++i) 
@@ -46,7 +55,7 @@ vkImage::CubeMap::CubeMap(TextureInputChunk input) :
 
 vkImage::CubeMap::~CubeMap()
 {
-	m_logicalDevice.freeMemory(m_imageMemory);
+	vkUtil::FreeMemory(m_logicalDevice, m_imageMemory);
 	m_logicalDevice.destroyImage(m_image);
 	m_logicalDevice.destroyImageView(m_imageView);
 	m_logicalDevice.destroySampler(m_sampler);
@@ -107,7 +116,7 @@ void vkImage::CubeMap::Populate()
 	TransitionImageLayout(transitionJob);
 
 	//Now the staging buffer can be destroyed
-	m_logicalDevice.freeMemory(stagingBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(m_logicalDevice, stagingBuffer.m_bufferMemory);
 	m_logicalDevice.destroyBuffer(stagingBuffer.m_buffer);
 }
 
@@ -34,6 +34,7 @@ namespace vkImage
 
 		vk::CommandBuffer m_commandBuffer;
 		vk::Queue m_queue;
+		std::mutex* m_uploadMutex;
 
 		void Load();
 
@@ -0,0 +1,159 @@
+#include "Culling.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#endif
+
+vkUtil::Frustum vkUtil::ExtractFrustum(const glm::mat4& viewProjection)
+{
+	//glm is column major, so rows have to be gathered
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	Frustum frustum;
+	frustum.m_planes[0] = rows[3] + rows[0];
+	frustum.m_planes[1] = rows[3] - rows[0];
+	frustum.m_planes[2] = rows[3] + rows[1];
+	frustum.m_planes[3] = rows[3] - rows[1];
+	frustum.m_planes[4] = rows[3] + rows[2];
+	frustum.m_planes[5] = rows[3] - rows[2];
+
+	for (glm::vec4& plane : frustum.m_planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+namespace
+{
+	/**
+		\returns the world space bounding sphere of one instance, center in xyz and radius in w
+	*/
+	glm::vec4 GetInstanceSphere(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, const vkUtil::MeshBounds& bounds)
+	{
+		glm::vec3 absScale = glm::abs(scale);
+		float maxScale = std::max(std::max(absScale.x, absScale.y), absScale.z);
+		return glm::vec4(position + rotation * (scale * bounds.m_center), bounds.m_radius * maxScale);
+	}
+}
+
+uint32_t vkUtil::CullSpheres(const Frustum& frustum, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, uint32_t count, const MeshBounds& bounds, uint32_t* visibleIndices)
+{
+	uint32_t visibleCount = 0;
+	uint32_t i = 0;
+
+#if defined(CULLING_AVX)
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.m_planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.m_planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.m_planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.m_planes[p].w);
+	}
+
+	alignas(32) float xs[8], ys[8], zs[8], negativeRadii[8];
+	for (; i + 8 <= count; i += 8)
+	{
+		//Instances are stored AoS, transpose their spheres into lanes
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			glm::vec4 sphere = GetInstanceSphere(positions[i + lane], rotations[i + lane], scales[i + lane], bounds);
+			xs[lane] = sphere.x;
+			ys[lane] = sphere.y;
+			zs[lane] = sphere.z;
+			negativeRadii[lane] = -sphere.w;
+		}
+		__m256 x = _mm256_load_ps(xs);
+		__m256 y = _mm256_load_ps(ys);
+		__m256 z = _mm256_load_ps(zs);
+		__m256 negativeRadius = _mm256_load_ps(negativeRadii);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		//Branchless compaction of the visible lanes
+		int mask = _mm256_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			visibleIndices[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#elif defined(CULLING_SSE)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.m_planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.m_planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.m_planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.m_planes[p].w);
+	}
+
+	alignas(16) float xs[4], ys[4], zs[4], negativeRadii[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		//Instances are stored AoS, transpose their spheres into lanes
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			glm::vec4 sphere = GetInstanceSphere(positions[i + lane], rotations[i + lane], scales[i + lane], bounds);
+			xs[lane] = sphere.x;
+			ys[lane] = sphere.y;
+			zs[lane] = sphere.z;
+			negativeRadii[lane] = -sphere.w;
+		}
+		__m128 x = _mm_load_ps(xs);
+		__m128 y = _mm_load_ps(ys);
+		__m128 z = _mm_load_ps(zs);
+		__m128 negativeRadius = _mm_load_ps(negativeRadii);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		//Branchless compaction of the visible lanes
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			visibleIndices[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	//Scalar tail (or the whole batch without SIMD support)
+	for (; i < count; ++i)
+	{
+		glm::vec4 sphere = GetInstanceSphere(positions[i], rotations[i], scales[i], bounds);
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.m_planes)
+		{
+			inside = inside && (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w >= -sphere.w);
+		}
+
+		visibleIndices[visibleCount] = i;
+		visibleCount += inside ? 1 : 0;
+	}
+
+	return visibleCount;
+}
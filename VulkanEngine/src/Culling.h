@@ -0,0 +1,39 @@
+#pragma once
+#include "Config.h"
+#include "RenderStructs.h"
+
+namespace vkUtil
+{
+	/**
+		The six planes of a view frustum, (a, b, c, d) with the normal
+		pointing inwards, normalized so d is a signed distance.
+		Order: left, right, bottom, top, near, far.
+	*/
+	struct Frustum
+	{
+		glm::vec4 m_planes[6];
+	};
+
+	/**
+		Extract the frustum planes from a combined view projection matrix.
+
+		\param viewProjection the camera's projection * view matrix
+		\returns the world space frustum
+	*/
+	Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+	/**
+		Frustum cull a batch of instances sharing a mesh, several instances per SIMD lane group
+		(8 with AVX, 4 with SSE, scalar otherwise).
+
+		\param frustum the world space frustum to test against
+		\param positions world space translation of each instance
+		\param rotations normalized orientation of each instance
+		\param scales per axis scale of each instance, the largest axis scales the radius
+		\param count the number of instances
+		\param bounds the model space bounds of the shared mesh
+		\param visibleIndices receives the indices of the visible instances, compacted, must hold count entries
+		\returns the number of visible instances
+	*/
+	uint32_t CullSpheres(const Frustum& frustum, const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, uint32_t count, const MeshBounds& bounds, uint32_t* visibleIndices);
+}
\ No newline at end of file
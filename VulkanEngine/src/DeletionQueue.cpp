@@ -0,0 +1,21 @@
+#include "DeletionQueue.h"
+
+void vkUtil::DeletionQueue::Push(uint64_t serial, std::function<void()> deleter)
+{
+	m_entries.emplace_back(serial, std::move(deleter));
+}
+
+void vkUtil::DeletionQueue::Flush(uint64_t completedSerial)
+{
+	//Serials only grow, so entries are in order
+	while (!m_entries.empty() && m_entries.front().first <= completedSerial)
+	{
+		m_entries.front().second();
+		m_entries.pop_front();
+	}
+}
+
+void vkUtil::DeletionQueue::FlushAll()
+{
+	Flush(std::numeric_limits<uint64_t>::max());
+}
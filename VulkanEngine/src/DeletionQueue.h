@@ -0,0 +1,36 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	/**
+		Defers destroying GPU objects until the submissions which may still use them have finished.
+		Submissions are identified by increasing serial numbers, completion is learnt from their fences.
+	*/
+	class DeletionQueue
+	{
+	public:
+		/**
+			Queue an object for destruction.
+
+			\param serial the last submission which may use the object
+			\param deleter destroys the object
+		*/
+		void Push(uint64_t serial, std::function<void()> deleter);
+
+		/**
+			Destroy every object whose last submission has finished, oldest first.
+
+			\param completedSerial every submission up to this one has finished
+		*/
+		void Flush(uint64_t completedSerial);
+
+		/**
+			Destroy everything, only once the device is idle.
+		*/
+		void FlushAll();
+
+	private:
+		std::deque<std::pair<uint64_t, std::function<void()>>> m_entries;
+	};
+}
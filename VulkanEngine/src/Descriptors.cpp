@@ -57,27 +57,40 @@ vk::DescriptorSetLayout vkInit::CreateDescriptorSetLayout(vk::Device device, con
 	}
 	catch (vk::SystemError err)
 	{
-		std::cout << "Failed to create Descriptor Set Layout" << std::endl;
-
-		return nullptr;
+		throw std::runtime_error("Failed to create descriptor set layout");
 	}
 }
 
-vk::DescriptorPool vkInit::CreateDescriptorPool(vk::Device device, uint32_t size, const DescriptorSetLayoutData& bindings)
+vk::DescriptorPool vkInit::CreateDescriptorPool(vk::Device device, const std::vector<DescriptorPoolRequest>& requests)
 {
+	//One pool size per descriptor type, counting every binding of every set
 	std::vector<vk::DescriptorPoolSize> poolSizes;
+	uint32_t maxSets = 0;
 
-	for (int i = 0; i < bindings.m_count; i++)
+	for (const DescriptorPoolRequest& request : requests)
 	{
-		vk::DescriptorPoolSize poolSize;
-		poolSize.type = bindings.m_types[i];
-		poolSize.descriptorCount = size;
-		poolSizes.push_back(poolSize);
+		maxSets += request.m_setCount;
+
+		for (int i = 0; i < request.m_bindings.m_count; i++)
+		{
+			uint32_t descriptorCount = static_cast<uint32_t>(request.m_bindings.m_counts[i]) * request.m_setCount;
+
+			auto poolSize = std::find_if(poolSizes.begin(), poolSizes.end(),
+				[&](const vk::DescriptorPoolSize& size) { return size.type == request.m_bindings.m_types[i]; });
+			if (poolSize != poolSizes.end())
+			{
+				poolSize->descriptorCount += descriptorCount;
+			}
+			else
+			{
+				poolSizes.push_back(vk::DescriptorPoolSize(request.m_bindings.m_types[i], descriptorCount));
+			}
+		}
 	}
 
 	vk::DescriptorPoolCreateInfo poolInfo;
 	poolInfo.flags = vk::DescriptorPoolCreateFlags();
-	poolInfo.maxSets = size;
+	poolInfo.maxSets = maxSets;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
 
@@ -21,11 +21,27 @@ namespace vkInit
 
 		\param device the logical device
 		\param bindings	a struct describing the bindings used in the shader
-		\returns the created descriptor set layout
+		\returns the created descriptor set layout, throws if it couldn't be created
 	*/
 	vk::DescriptorSetLayout CreateDescriptorSetLayout(vk::Device device, const DescriptorSetLayoutData& bindings);
 
-	vk::DescriptorPool CreateDescriptorPool(vk::Device device, uint32_t size, const DescriptorSetLayoutData& bindings);
+	/**
+		Sets of one layout a descriptor pool has to hold
+	*/
+	struct DescriptorPoolRequest
+	{
+		DescriptorSetLayoutData m_bindings;
+		uint32_t m_setCount;
+	};
+
+	/**
+		Make a descriptor pool holding exactly the requested sets
+
+		\param device the logical device
+		\param requests the layouts allocated from the pool, each with how many sets of it
+		\returns the created descriptor pool
+	*/
+	vk::DescriptorPool CreateDescriptorPool(vk::Device device, const std::vector<DescriptorPoolRequest>& requests);
 
 	vk::DescriptorSet AllocateDescriptorSet(vk::Device device, vk::DescriptorPool descriptorPool, vk::DescriptorSetLayout layout);
 }
\ No newline at end of file
@@ -57,14 +57,18 @@ namespace vkInit
 	/**
 		Check whether the given physical device is suitable for the system.
 		\param device the physical device to check.
+		\param headless whether the device only renders offscreen, then anything goes.
 		\debug whether the system is running in debug mode.
 		\returns whether the device is suitable.
 	*/
-	bool CheckSuitable(const vk::PhysicalDevice& device, const bool debug) 
+	bool CheckSuitable(const vk::PhysicalDevice& device, const bool headless, const bool debug) 
 	{
 		if (debug) 
 			std::cout << "Checking if device is suitable\n";
 
+		if (headless)
+			return true;
+
 		/*
 		* A device is suitable if it can present to the screen, ie support
 		* the swapchain extension
@@ -102,10 +106,11 @@ namespace vkInit
 	/**
 		Choose a physical device for the vulkan instance.
 		\param instance the vulkan instance to use
+		\param headless whether the device only renders offscreen
 		\param debug whether the system is running in debug mode
 		\returns the chosen physical device
 	*/
-	vk::PhysicalDevice ChoosePhysicalDevice(const vk::Instance& instance, const bool debug) 
+	vk::PhysicalDevice ChoosePhysicalDevice(const vk::Instance& instance, const bool headless, const bool debug) 
 	{
 
 		/*
@@ -135,7 +140,7 @@ namespace vkInit
 			//if (debug) 
 			//	LogDeviceProperties(device);
 
-			if (CheckSuitable(device, debug)) return device;
+			if (CheckSuitable(device, headless, debug)) return device;
 		}
 
 		return nullptr;
@@ -144,6 +149,7 @@ namespace vkInit
 	/**
 		Create a Vulkan device
 		\param physicalDevice the Physical Device to represent
+		\param surface the surface to present to, nullptr when headless
 		\param debug whether the system is running in debug mode
 		\returns the created device
 	*/
@@ -182,15 +188,21 @@ namespace vkInit
 		* therefore we only pay for what we need.
 		*/
 
+		vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
 		vk::PhysicalDeviceFeatures deviceFeatures{};
 
+		// One indirect call can cover every mesh type
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+		// Materials are picked from a descriptor array with a per draw index
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+
 		/*
 		*	Device extensions to be requested:
 		*/
-		std::vector<const char*> deviceExtensions
-		{
-			VK_KHR_SWAPCHAIN_EXTENSION_NAME
-		};
+		std::vector<const char*> deviceExtensions;
+		if (surface)
+			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
 		/*
 		* VULKAN_HPP_CONSTEXPR DeviceCreateInfo( VULKAN_HPP_NAMESPACE::DeviceCreateFlags flags_                         = {},
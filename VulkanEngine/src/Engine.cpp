@@ -4,6 +4,8 @@
 #include "Device.h"
 #include "SwapChain.h"
 #include "Pipeline.h"
+#include "PipelineCache.h"
+#include "ObjectCache.h"
 #include "Framebuffer.h"
 #include "Commands.h"
 #include "Sync.h"
@@ -12,14 +14,25 @@
 #include "Mesh.h"
 #include "Texture.h"
 #include "CubeMap.h"
+#include "Transforms.h"
+#include "Memory.h"
+#include "SingleTimeCommands.h"
+#include "CpuProfiler.h"
 
-Engine::Engine(int width, int height, GLFWwindow* window)
+Engine::Engine(int width, int height, GLFWwindow* window, bool gpuCulling)
 	: m_width{ width },
 	m_height{ height },
-	m_window{ window }
+	m_window{ window },
+	m_headless{ window == nullptr },
+	m_gpuCulling{ gpuCulling }
 {
 	if (m_debugMode) 
+	{
 		std::cout << "Creating the graphics engine: LearnVulkanEngine\n";
+		std::cout << "Culling on the " << (m_gpuCulling ? "GPU" : "CPU") << "\n";
+	}
+
+	vkUtil::CpuZone zone("Engine startup");
 
 	CreateInstance();
 	CreateDevice();
@@ -27,22 +40,24 @@ Engine::Engine(int width, int height, GLFWwindow* window)
 	CreatePipeline();
 	FinalSetup();
 	CreateAssets();
+	CreateFrameResources();
 }
 
 void Engine::DestroySwapChain()
 {
-	for (vkUtil::SwapChainFrame& frame : m_swapChainFrames)
+	for (vkUtil::SwapChainImage& image : m_swapChainImages)
 	{
-		frame.Destroy();
+		image.Destroy();
 	}
 
-	m_device.destroySwapchainKHR(m_swapChain);
-
-	m_device.destroyDescriptorPool(m_frameDescriptorPool);
+	if (m_swapChain)
+		m_device.destroySwapchainKHR(m_swapChain);
 }
 
 Engine::~Engine() 
 {
+	vkUtil::CpuZone zone("Engine shutdown");
+
 	m_device.waitIdle();
 
 	if (m_debugMode) 
@@ -50,24 +65,37 @@ Engine::~Engine()
 
 	m_device.destroyCommandPool(m_commandPool);
 
-	for (PipelineTypes pipelineType : m_pipelineTypes)
-	{
-		m_device.destroyPipeline(m_pipeline[pipelineType]);
-		m_device.destroyPipelineLayout(m_pipelineLayout[pipelineType]);
-		m_device.destroyRenderPass(m_renderPass[pipelineType]);
-	}
+	//Background compiles have to finish before their results can be destroyed, and they run on the job system
+	CollectPipelines(true);
+
+	delete m_jobs;
+	delete m_gpuProfiler;
+
+	//Pipelines, layouts, renderpasses and descriptor set layouts are all owned by the cache
+	delete m_objectCache;
 
+	vkInit::SavePipelineCache(m_device, m_physicalDevice, m_pipelineCache, m_pipelineCacheFilename, m_debugMode);
+	m_device.destroyPipelineCache(m_pipelineCache);
+
+	m_deletionQueue.FlushAll();
 	DestroySwapChain();
 
-	for (PipelineTypes pipelineType : m_pipelineTypes)
+	for (vkUtil::SwapChainFrame& frame : m_frames)
 	{
-		m_device.destroyDescriptorSetLayout(m_frameSetLayout[pipelineType]);
-		m_device.destroyDescriptorSetLayout(m_meshSetLayout[pipelineType]);
+		frame.Destroy();
 	}
+
+	m_device.destroyDescriptorPool(m_frameDescriptorPool);
+	m_device.destroyDescriptorPool(m_cullDescriptorPool);
+	m_device.destroyDescriptorPool(m_scatterDescriptorPool);
+
 	m_device.destroyDescriptorPool(m_meshDescriptorPool);
 
 	delete m_meshes;
 
+	vkUtil::FreeMemory(m_device, m_drawDataBuffer.m_bufferMemory);
+	m_device.destroyBuffer(m_drawDataBuffer.m_buffer);
+
 	for (const auto& [key, texture] : m_materials)
 	{
 		delete texture;
@@ -77,7 +105,8 @@ Engine::~Engine()
 
 	m_device.destroy();
 
-	m_instance.destroySurfaceKHR(m_surface);
+	if (m_surface)
+		m_instance.destroySurfaceKHR(m_surface);
 
 	if (m_debugMode)
 		m_instance.destroyDebugUtilsMessengerEXT(m_debugMessenger, nullptr, m_dispatchLoaderInstance);
@@ -88,12 +117,18 @@ Engine::~Engine()
 
 void Engine::CreateInstance()
 {
-	m_instance = vkInit::CreateInstance(m_debugMode, "LearnVulkanEngine");
+	vkUtil::CpuZone zone("CreateInstance");
+
+	m_instance = vkInit::CreateInstance(m_debugMode, "LearnVulkanEngine", m_headless);
 	m_dispatchLoaderInstance = vk::DispatchLoaderDynamic(m_instance, vkGetInstanceProcAddr);
 
 	if (m_debugMode)
 		m_debugMessenger = vkInit::CreateDebugMessenger(m_instance, m_dispatchLoaderInstance);
 
+	//Headless rendering has nowhere to present
+	if (m_headless)
+		return;
+
 	VkSurfaceKHR cStyleSurface;
 	if (glfwCreateWindowSurface(m_instance, m_window, nullptr, &cStyleSurface) != VK_SUCCESS) 
 	{
@@ -111,12 +146,27 @@ void Engine::CreateInstance()
 
 void Engine::CreateDevice()
 {
-	m_physicalDevice = vkInit::ChoosePhysicalDevice(m_instance, m_debugMode);
+	vkUtil::CpuZone zone("CreateDevice");
+
+	m_physicalDevice = vkInit::ChoosePhysicalDevice(m_instance, m_headless, m_debugMode);
 	m_device = vkInit::CreateLogicalDevice(m_physicalDevice, m_surface, m_debugMode);
+	m_multiDrawIndirect = m_physicalDevice.getFeatures().multiDrawIndirect;
 	std::array<vk::Queue, 2> queues = vkInit::GetQueues(m_physicalDevice, m_device, m_surface, m_debugMode);
 	m_graphicsQueue = queues[0];
 	m_presentQueue = queues[1];
-	CreateSwapChain();
+
+	//Pipelines and their state objects are shared through the object cache from here on
+	m_pipelineCache = vkInit::CreatePipelineCache(m_device, m_physicalDevice, m_pipelineCacheFilename, m_debugMode);
+	m_objectCache = new vkInit::ObjectCache(m_device, m_pipelineCache);
+
+	//Pipelines compile on the job system, so it starts before them.
+	//hardware_concurrency may report 0 when unknown
+	m_jobs = new vkUtil::JobSystem(std::max(std::thread::hardware_concurrency(), 1u));
+
+	if (m_headless)
+		CreateOffscreenTargets();
+	else
+		CreateSwapChain(nullptr);
 	m_frameNumber = 0;
 }
 
@@ -130,7 +180,7 @@ void Engine::CreateDescriptorSetLayout()
 	bindings.m_counts.push_back(1);
 	bindings.m_stages.push_back(vk::ShaderStageFlagBits::eVertex);
 
-	m_frameSetLayout[PipelineTypes::SKY] = vkInit::CreateDescriptorSetLayout(m_device, bindings);
+	m_frameSetLayout[PipelineTypes::SKY] = m_objectCache->GetDescriptorSetLayout(bindings);
 
 	bindings.m_count = 2;
 
@@ -139,7 +189,39 @@ void Engine::CreateDescriptorSetLayout()
 	bindings.m_counts.push_back(1);
 	bindings.m_stages.push_back(vk::ShaderStageFlagBits::eVertex);
 
-	m_frameSetLayout[PipelineTypes::STANDARD] = vkInit::CreateDescriptorSetLayout(m_device, bindings);
+	bindings.m_count = 4;
+
+	//Visible indices, instance meshes
+	for (int i = 2; i < bindings.m_count; ++i)
+	{
+		bindings.m_indices.push_back(i);
+		bindings.m_types.push_back(vk::DescriptorType::eStorageBuffer);
+		bindings.m_counts.push_back(1);
+		bindings.m_stages.push_back(vk::ShaderStageFlagBits::eVertex);
+	}
+
+	m_frameSetLayout[PipelineTypes::STANDARD] = m_objectCache->GetDescriptorSetLayout(bindings);
+
+	//Culling: transforms, mesh indices, mesh bounds, draw commands, visible indices
+	vkInit::DescriptorSetLayoutData cullBindings;
+	cullBindings.m_count = 5;
+	for (int i = 0; i < cullBindings.m_count; ++i)
+	{
+		cullBindings.m_indices.push_back(i);
+		cullBindings.m_types.push_back(vk::DescriptorType::eStorageBuffer);
+		cullBindings.m_counts.push_back(1);
+		cullBindings.m_stages.push_back(vk::ShaderStageFlagBits::eCompute);
+	}
+
+	m_cullSetLayout = m_objectCache->GetDescriptorSetLayout(cullBindings);
+
+	//Instance expansion: instances, transforms, changed slots
+	cullBindings.m_count = 3;
+	m_expandSetLayout = m_objectCache->GetDescriptorSetLayout(cullBindings);
+
+	//Transform scatter: upload list, instances
+	cullBindings.m_count = 2;
+	m_scatterSetLayout = m_objectCache->GetDescriptorSetLayout(cullBindings);
 
 	bindings.m_count = 1;
 
@@ -148,90 +230,233 @@ void Engine::CreateDescriptorSetLayout()
 	bindings.m_counts[0] = 1;
 	bindings.m_stages[0] = vk::ShaderStageFlagBits::eFragment;
 
-	m_meshSetLayout[PipelineTypes::SKY] = vkInit::CreateDescriptorSetLayout(m_device, bindings);
-	m_meshSetLayout[PipelineTypes::STANDARD] = vkInit::CreateDescriptorSetLayout(m_device, bindings);
+	m_meshSetLayout[PipelineTypes::SKY] = m_objectCache->GetDescriptorSetLayout(bindings);
+
+	//Every material at once, plus the per draw material slots
+	bindings.m_count = 2;
+
+	bindings.m_counts[0] = MeshTypeCount;
+
+	bindings.m_indices[1] = 1;
+	bindings.m_types[1] = vk::DescriptorType::eStorageBuffer;
+	bindings.m_counts[1] = 1;
+	bindings.m_stages[1] = vk::ShaderStageFlagBits::eVertex;
+
+	m_meshSetLayout[PipelineTypes::STANDARD] = m_objectCache->GetDescriptorSetLayout(bindings);
 }
 
 void Engine::CreatePipeline()
 {
-	vkInit::PipelineBuilder pipelineBuilder(m_device);
+	vkUtil::CpuZone zone("CreatePipeline");
 
 	//Sky
-	pipelineBuilder.SetOverwriteMode(false);
-	pipelineBuilder.SpecifyVertexShader("shaders/sky_vertex.spv");
-	pipelineBuilder.SpecifyFragmentShader("shaders/sky_fragment.spv");
-	pipelineBuilder.SpecifySwapChainExtent(m_swapChainExtent);
-	pipelineBuilder.ClearDepthAttachment();
-	pipelineBuilder.AddDescriptorSetLayout(m_frameSetLayout[PipelineTypes::SKY]);
-	pipelineBuilder.AddDescriptorSetLayout(m_meshSetLayout[PipelineTypes::SKY]);
-	pipelineBuilder.AddColorAttachment(m_swapChainFormat, 0);
-
-	vkInit::GraphicsPipelineOutBundle output = pipelineBuilder.Build();
-
-	m_pipelineLayout[PipelineTypes::SKY] = output.layout;
-	m_renderPass[PipelineTypes::SKY] = output.renderpass;
-	m_pipeline[PipelineTypes::SKY] = output.pipeline;
-	pipelineBuilder.Reset();
+	vkInit::GraphicsPipelineDescription skyDescription;
+	skyDescription.vertexShader = "shaders/sky_vertex.spv";
+	skyDescription.fragmentShader = "shaders/sky_fragment.spv";
+	skyDescription.colorFormat = m_swapChainFormat;
+	skyDescription.colorLayout = m_headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+	skyDescription.overwrite = false;
+	skyDescription.descriptorSetLayouts = { m_frameSetLayout[PipelineTypes::SKY], m_meshSetLayout[PipelineTypes::SKY] };
 
 	//Standard
-	pipelineBuilder.SetOverwriteMode(true);
-	pipelineBuilder.SpecifyVertexFormat(
-		vkMesh::GetPosColorBindingDescription(),
-		vkMesh::GetPosColorAttributeDescriptions());
-	pipelineBuilder.SpecifyVertexShader("shaders/vertex.spv");
-	pipelineBuilder.SpecifyFragmentShader("shaders/fragment.spv");
-	pipelineBuilder.SpecifySwapChainExtent(m_swapChainExtent);
-	pipelineBuilder.SpecifyDepthAttachment(m_swapChainFrames[0].depthFormat, 1);
-	pipelineBuilder.AddDescriptorSetLayout(m_frameSetLayout[PipelineTypes::STANDARD]);
-	pipelineBuilder.AddDescriptorSetLayout(m_meshSetLayout[PipelineTypes::STANDARD]);
-	pipelineBuilder.AddColorAttachment(m_swapChainFormat, 0);
+	vkInit::GraphicsPipelineDescription standardDescription;
+	standardDescription.vertexShader = "shaders/vertex.spv";
+	standardDescription.fragmentShader = "shaders/fragment.spv";
+	standardDescription.bindingDescription = vkMesh::GetPosColorBindingDescription();
+	standardDescription.attributeDescriptions = vkMesh::GetPosColorAttributeDescriptions();
+	standardDescription.colorFormat = m_swapChainFormat;
+	standardDescription.colorLayout = skyDescription.colorLayout;
+	standardDescription.depthFormat = m_swapChainImages[0].depthFormat;
+	standardDescription.overwrite = true;
+	standardDescription.descriptorSetLayouts = { m_frameSetLayout[PipelineTypes::STANDARD], m_meshSetLayout[PipelineTypes::STANDARD] };
+	standardDescription.features = ShaderFeatures::SunLight | ShaderFeatures::AlbedoTexture | ShaderFeatures::VertexColor;
+
+	//Flat shaded stand in for the standard pipeline, same layout and render pass
+	vkInit::GraphicsPipelineDescription flatDescription = standardDescription;
+	flatDescription.features = ShaderFeatures::VertexColor;
+
+	//Everything compiles in parallel. The full standard variant isn't needed for the first frame,
+	//the flat one is drawn instead until it's ready.
+	m_pendingPipelines[PipelineTypes::SKY] = vkInit::CompileGraphicsPipelineAsync(*m_jobs, *m_objectCache, skyDescription);
+	m_pendingPipelines[PipelineTypes::STANDARD_FLAT] = vkInit::CompileGraphicsPipelineAsync(*m_jobs, *m_objectCache, flatDescription);
+	m_pendingPipelines[PipelineTypes::STANDARD] = vkInit::CompileGraphicsPipelineAsync(*m_jobs, *m_objectCache, standardDescription);
+	m_pipelineFallback[PipelineTypes::STANDARD] = PipelineTypes::STANDARD_FLAT;
+
+	//Culling
+	vkInit::PendingComputePipeline cullPipeline;
+	if (m_gpuCulling)
+	{
+		vkInit::ComputePipelineDescription cullDescription;
+		cullDescription.computeShader = "shaders/cull_compute.spv";
+		cullDescription.descriptorSetLayouts = { m_cullSetLayout };
+		cullDescription.pushConstantSize = sizeof(vkUtil::CullParameters);
+		cullPipeline = vkInit::CompileComputePipelineAsync(*m_jobs, *m_objectCache, cullDescription);
+	}
+
+	//Transform scatter
+	vkInit::ComputePipelineDescription scatterDescription;
+	scatterDescription.computeShader = "shaders/scatter_compute.spv";
+	scatterDescription.descriptorSetLayouts = { m_scatterSetLayout };
+	scatterDescription.pushConstantSize = sizeof(vkUtil::ScatterParameters);
+	vkInit::PendingComputePipeline scatterPipeline = vkInit::CompileComputePipelineAsync(*m_jobs, *m_objectCache, scatterDescription);
+
+	//Instance expansion
+	vkInit::ComputePipelineDescription expandDescription;
+	expandDescription.computeShader = "shaders/expand_compute.spv";
+	expandDescription.descriptorSetLayouts = { m_expandSetLayout };
+	expandDescription.pushConstantSize = sizeof(vkUtil::ExpandParameters);
+	vkInit::PendingComputePipeline expandPipeline = vkInit::CompileComputePipelineAsync(*m_jobs, *m_objectCache, expandDescription);
+
+	CollectPipeline(PipelineTypes::SKY);
+	CollectPipeline(PipelineTypes::STANDARD_FLAT);
+
+	//Readbacks have to be reproducible, so headless never draws with a fallback
+	if (m_headless)
+		CollectPipelines(true);
+	else
+		CollectPipelines(false);
+
+	if (m_gpuCulling)
+	{
+		vkInit::ComputePipelineOutBundle cullOutput = cullPipeline.Get();
+		m_cullPipelineLayout = cullOutput.layout;
+		m_cullPipeline = cullOutput.pipeline;
+	}
+
+	vkInit::ComputePipelineOutBundle scatterOutput = scatterPipeline.Get();
+	m_scatterPipelineLayout = scatterOutput.layout;
+	m_scatterPipeline = scatterOutput.pipeline;
 
-	output = pipelineBuilder.Build();
+	vkInit::ComputePipelineOutBundle expandOutput = expandPipeline.Get();
+	m_expandPipelineLayout = expandOutput.layout;
+	m_expandPipeline = expandOutput.pipeline;
+}
+
+void Engine::CollectPipelines(bool wait)
+{
+	std::vector<PipelineTypes> ready;
+	for (const auto& [pipelineType, pending] : m_pendingPipelines)
+	{
+		if (wait || pending.IsReady())
+			ready.push_back(pipelineType);
+	}
+
+	for (PipelineTypes pipelineType : ready)
+	{
+		CollectPipeline(pipelineType);
+	}
+}
+
+void Engine::CollectPipeline(PipelineTypes pipelineType)
+{
+	auto pending = m_pendingPipelines.find(pipelineType);
+	if (pending == m_pendingPipelines.end())
+		return;
+
+	vkInit::GraphicsPipelineOutBundle output = pending->second.Get();
+	m_pendingPipelines.erase(pending);
+
+	m_pipelineLayout[pipelineType] = output.layout;
+	m_renderPass[pipelineType] = output.renderpass;
+	m_pipeline[pipelineType] = output.pipeline;
+
+	for (const auto& [standIn, fallback] : m_pipelineFallback)
+	{
+		if (fallback == pipelineType && !m_pipeline.count(standIn))
+		{
+			//Recording and framebuffers use the pending pipeline's layout and render pass already
+			m_pipelineLayout[standIn] = output.layout;
+			m_renderPass[standIn] = output.renderpass;
+		}
+		else if (standIn == pipelineType && m_pipeline.count(fallback)
+			&& (m_pipelineLayout[fallback] != output.layout || m_renderPass[fallback] != output.renderpass))
+		{
+			throw std::logic_error("A fallback pipeline doesn't share its layout and render pass with the pipeline it stands in for");
+		}
+	}
+}
+
+vk::Pipeline Engine::GetPipeline(PipelineTypes pipelineType) const
+{
+	//Const lookups only, this runs on job threads while recording
+	auto pipeline = m_pipeline.find(pipelineType);
+	if (pipeline != m_pipeline.end())
+		return pipeline->second;
 
-	m_pipelineLayout[PipelineTypes::STANDARD] = output.layout;
-	m_renderPass[PipelineTypes::STANDARD] = output.renderpass;
-	m_pipeline[PipelineTypes::STANDARD] = output.pipeline;
+	return m_pipeline.at(m_pipelineFallback.at(pipelineType));
 }
 
-void Engine::CreateSwapChain()
+void Engine::CreateSwapChain(vk::SwapchainKHR oldSwapChain)
 {
-	vkInit::SwapChainBundle bundle = vkInit::CreateSwapChain(m_device, m_physicalDevice, m_surface, m_width, m_height, m_debugMode);
+	vkInit::SwapChainBundle bundle = vkInit::CreateSwapChain(m_device, m_physicalDevice, m_surface, m_width, m_height, m_requestedPresentMode, oldSwapChain, m_debugMode);
 	m_swapChain = bundle.swapchain;
-	m_swapChainFrames = bundle.frames;
+	m_swapChainImages = bundle.frames;
 	m_swapChainFormat = bundle.format;
 	m_swapChainExtent = bundle.extent;
-	m_maxFramesInFlight = static_cast<int>(m_swapChainFrames.size());
+	m_presentMode = bundle.presentMode;
+	m_supportedPresentModes = bundle.supportedPresentModes;
 
-	for (vkUtil::SwapChainFrame& frame : m_swapChainFrames)
+	for (vkUtil::SwapChainImage& image : m_swapChainImages)
 	{
-		frame.logicalDevice = m_device;
-		frame.physicalDevice = m_physicalDevice;
-		frame.width = m_swapChainExtent.width;
-		frame.height = m_swapChainExtent.height;
+		image.logicalDevice = m_device;
+		image.physicalDevice = m_physicalDevice;
+		image.width = m_swapChainExtent.width;
+		image.height = m_swapChainExtent.height;
+
+		image.CreateDepthResources();
+		image.renderFinished = vkInit::CreateSemaphore(m_device, m_debugMode);
+	}
+}
 
-		frame.CreateDepthResources();
+void Engine::CreateOffscreenTargets()
+{
+	//Same format a window would most likely get, so both modes render alike
+	m_swapChainFormat = vk::Format::eB8G8R8A8Unorm;
+	m_swapChainExtent = vk::Extent2D{ static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height) };
+
+	//One target per frame in flight, guarded by the frame's fence the way acquire guards a swapchain image
+	m_swapChainImages.resize(m_maxFramesInFlight);
+	for (vkUtil::SwapChainImage& image : m_swapChainImages)
+	{
+		image.logicalDevice = m_device;
+		image.physicalDevice = m_physicalDevice;
+		image.width = m_swapChainExtent.width;
+		image.height = m_swapChainExtent.height;
+
+		image.CreateOffscreenImage(m_swapChainFormat);
+		image.CreateDepthResources();
 	}
 }
 
 void Engine::RecreateSwapChain()
 {
-	m_width = 0;
-	m_height = 0;
+	vkUtil::CpuZone zone("RecreateSwapChain");
+
+	//Only block while minimized
+	glfwGetFramebufferSize(m_window, &m_width, &m_height);
 	while (m_width == 0 || m_height == 0)
 	{
-		glfwGetFramebufferSize(m_window, &m_width, &m_height);
 		glfwWaitEvents();
+		glfwGetFramebufferSize(m_window, &m_width, &m_height);
 	}
 
-	m_device.waitIdle();
+	//Frames in flight don't depend on the swapchain, only the per image attachments are rebuilt.
+	//The old ones may still be in use, so they are retired rather than destroyed.
+	vk::SwapchainKHR oldSwapChain = m_swapChain;
+	std::vector<vkUtil::SwapChainImage> oldImages = std::move(m_swapChainImages);
 
-	DestroySwapChain();
-	CreateSwapChain();
+	CreateSwapChain(oldSwapChain);
 	CreateFrameBuffers();
-	CreateFrameResources();
 
-	vkInit::CommandBufferInputChunk commandBufferInput = { m_device, m_commandPool, m_swapChainFrames };
-	vkInit::CreateFrameCommandBuffers(commandBufferInput, m_debugMode);
+	//Retired once the first frame on the new swapchain finished, by then the queue is done with the old presents
+	m_deletionQueue.Push(m_submittedSerial + 1, [device = m_device, oldSwapChain, oldImages]() mutable
+		{
+			for (vkUtil::SwapChainImage& image : oldImages)
+			{
+				image.Destroy();
+			}
+			device.destroySwapchainKHR(oldSwapChain);
+		});
 }
 
 void Engine::CreateFrameBuffers()
@@ -240,48 +465,83 @@ void Engine::CreateFrameBuffers()
 	frameBufferInput.device = m_device;
 	frameBufferInput.renderPass = m_renderPass;
 	frameBufferInput.swapChainExtent = m_swapChainExtent;
-	vkInit::CreateFramebuffers(frameBufferInput, m_swapChainFrames, m_debugMode);
+	vkInit::CreateFramebuffers(frameBufferInput, m_swapChainImages, m_debugMode);
 }
 
 void Engine::CreateFrameResources()
 {
-	vkInit::DescriptorSetLayoutData bindings;
-	bindings.m_count = 2;
-	bindings.m_types.push_back(vk::DescriptorType::eUniformBuffer);
-	bindings.m_types.push_back(vk::DescriptorType::eStorageBuffer);
-	uint32_t descriptorSetsPerFrame = 2;
+	vkUtil::CpuZone zone("CreateFrameResources");
+
+	//Pools hold exactly the sets allocated per frame below
+	uint32_t frameCount = static_cast<uint32_t>(m_frames.size());
+	m_frameDescriptorPool = vkInit::CreateDescriptorPool(m_device, {
+		{ m_objectCache->GetDescriptorSetLayoutData(m_frameSetLayout[PipelineTypes::SKY]), frameCount },
+		{ m_objectCache->GetDescriptorSetLayoutData(m_frameSetLayout[PipelineTypes::STANDARD]), frameCount } });
 
-	m_frameDescriptorPool = vkInit::CreateDescriptorPool(m_device, static_cast<uint32_t>(m_swapChainFrames.size() * descriptorSetsPerFrame), bindings);
+	if (m_gpuCulling)
+		m_cullDescriptorPool = vkInit::CreateDescriptorPool(m_device, { { m_objectCache->GetDescriptorSetLayoutData(m_cullSetLayout), frameCount } });
 
-	for (vkUtil::SwapChainFrame& frame : m_swapChainFrames)
+	//Scatter and expansion sets share a pool
+	m_scatterDescriptorPool = vkInit::CreateDescriptorPool(m_device, {
+		{ m_objectCache->GetDescriptorSetLayoutData(m_scatterSetLayout), frameCount },
+		{ m_objectCache->GetDescriptorSetLayoutData(m_expandSetLayout), frameCount } });
+
+	for (vkUtil::SwapChainFrame& frame : m_frames)
 	{
 		frame.imageAvailable = vkInit::CreateSemaphore(m_device, m_debugMode);
-		frame.renderFinished = vkInit::CreateSemaphore(m_device, m_debugMode);
 		frame.inFlight = vkInit::CreateFence(m_device, m_debugMode);
+		m_inFlightFences.push_back(frame.inFlight);
+
+		frame.gpuCulling = m_gpuCulling;
+		frame.drawCommands.resize(MeshTypeCount);
+		frame.meshBoundsDescriptor.buffer = m_meshes->m_boundsBuffer.m_buffer;
+		frame.meshBoundsDescriptor.offset = 0;
+		frame.meshBoundsDescriptor.range = VK_WHOLE_SIZE;
 
 		frame.CreateDescriptorResources();
 
 		frame.descriptorSet[PipelineTypes::SKY] = vkInit::AllocateDescriptorSet(m_device, m_frameDescriptorPool, m_frameSetLayout[PipelineTypes::SKY]);
 		frame.descriptorSet[PipelineTypes::STANDARD] = vkInit::AllocateDescriptorSet(m_device, m_frameDescriptorPool, m_frameSetLayout[PipelineTypes::STANDARD]);
 
+		if (m_gpuCulling)
+			frame.cullDescriptorSet = vkInit::AllocateDescriptorSet(m_device, m_cullDescriptorPool, m_cullSetLayout);
+		frame.scatterDescriptorSet = vkInit::AllocateDescriptorSet(m_device, m_scatterDescriptorPool, m_scatterSetLayout);
+		frame.expandDescriptorSet = vkInit::AllocateDescriptorSet(m_device, m_scatterDescriptorPool, m_expandSetLayout);
+
 		frame.RecordWriteOperations();
+		frame.WriteDescriptorSet();
 	}
 }
 
 void Engine::FinalSetup()
 {
+	vkUtil::CpuZone zone("FinalSetup");
+
 	CreateFrameBuffers();
 	m_commandPool = vkInit::CreateCommandPool(m_device, m_physicalDevice, m_surface, m_debugMode);
 
-	vkInit::CommandBufferInputChunk commandBufferInput = { m_device, m_commandPool, m_swapChainFrames };
+	m_frames.resize(m_maxFramesInFlight);
+	for (vkUtil::SwapChainFrame& frame : m_frames)
+	{
+		frame.logicalDevice = m_device;
+		frame.physicalDevice = m_physicalDevice;
+	}
+
+	vkInit::CommandBufferInputChunk commandBufferInput = { m_device, m_commandPool, m_frames };
 	m_mainCommandBuffer = vkInit::CreateCommandBuffer(commandBufferInput, m_debugMode);
 	vkInit::CreateFrameCommandBuffers(commandBufferInput, m_debugMode);
 
-	CreateFrameResources();
+
+	vkUtil::QueueFamilyIndices queueFamilyIndices = vkUtil::FindQueueFamilies(m_physicalDevice, m_surface, false);
+	m_gpuProfiler = new vkUtil::GpuProfiler(m_device, m_physicalDevice, queueFamilyIndices.graphicsFamily.value(), m_maxFramesInFlight, 16);
+	if (m_debugMode)
+		m_gpuProfiler->SetReportInterval(5.0);
 }
 
 void Engine::CreateAssets()
 {
+	vkUtil::CpuZone zone("CreateAssets");
+
 	m_meshes = new VertexManager();
 	std::unordered_map<MeshTypes, std::vector<const char*>> modelFilenames =
 	{
@@ -299,20 +559,6 @@ void Engine::CreateAssets()
 		{MeshTypes::ROOM, glm::rotate(glm::mat4(1.f), glm::radians(135.f), glm::vec3(0.f, 0.f, 1.f))}
 	};
 
-	for (std::pair<MeshTypes, std::vector<const char*>> pair : modelFilenames)
-	{
-		vkMesh::ObjMesh model(preTransforms[pair.first], pair.second[0], pair.second[1]);
-		m_meshes->Consume(pair.first, model.m_vertices, model.m_indices);
-	}
-
-	FinalizationChunk finalizationChunk;
-	finalizationChunk.m_logicalDevice = m_device;
-	finalizationChunk.m_physicalDevice = m_physicalDevice;
-	finalizationChunk.m_queue = m_graphicsQueue;
-	finalizationChunk.m_commandBuffer = m_mainCommandBuffer;
-
-	m_meshes->Finalize(finalizationChunk);
-
 	//Materials
 	std::unordered_map<MeshTypes, std::vector<const char*>> filenames
 	{
@@ -322,31 +568,72 @@ void Engine::CreateAssets()
 		{ MeshTypes::ROOM, {"./textures/viking_room.png"} }
 	};
 
-	//Make a descriptor pool to allocate sets
-	vkInit::DescriptorSetLayoutData bindings;
-	bindings.m_count = 1;
-	bindings.m_types.push_back(vk::DescriptorType::eCombinedImageSampler);
+	//The material set and the sky's set
+	m_meshDescriptorPool = vkInit::CreateDescriptorPool(m_device, {
+		{ m_objectCache->GetDescriptorSetLayoutData(m_meshSetLayout[PipelineTypes::STANDARD]), 1 },
+		{ m_objectCache->GetDescriptorSetLayoutData(m_meshSetLayout[PipelineTypes::SKY]), 1 } });
+
+	//Every file is parsed and decoded as its own job. Uploads share the main command buffer,
+	//the graphics queue and the descriptor pool, so they take turns on this mutex.
+	std::mutex uploadMutex;
+	std::vector<vkUtil::JobHandle> loads;
+
+	std::array<std::unique_ptr<vkMesh::ObjMesh>, MeshTypeCount> models;
+	std::vector<vkUtil::JobHandle> modelLoads;
+	for (const auto& [meshType, modelFilename] : modelFilenames)
+	{
+		modelLoads.push_back(m_jobs->Schedule([&models, meshType, preTransform = preTransforms[meshType], modelFilename]()
+			{
+				models[static_cast<uint32_t>(meshType)] = std::make_unique<vkMesh::ObjMesh>(preTransform, modelFilename[0], modelFilename[1]);
+			}));
+	}
 
-	m_meshDescriptorPool = vkInit::CreateDescriptorPool(m_device, static_cast<uint32_t>(filenames.size() + 1), bindings);
+	FinalizationChunk finalizationChunk;
+	finalizationChunk.m_logicalDevice = m_device;
+	finalizationChunk.m_physicalDevice = m_physicalDevice;
+	finalizationChunk.m_queue = m_graphicsQueue;
+	finalizationChunk.m_commandBuffer = m_mainCommandBuffer;
 
+	//Consumed in mesh type order whichever model finished first, so the vertex buffer layout is always the same
+	loads.push_back(m_jobs->Schedule([this, &models, &uploadMutex, &finalizationChunk]()
+		{
+			for (uint32_t i = 0; i < MeshTypeCount; ++i)
+			{
+				if (models[i])
+					m_meshes->Consume(static_cast<MeshTypes>(i), models[i]->m_vertices, models[i]->m_indices, models[i]->m_bounds);
+			}
+
+			std::lock_guard<std::mutex> lock(uploadMutex);
+			m_meshes->Finalize(finalizationChunk);
+		}, modelLoads));
 
 	vkImage::TextureInputChunk textureInfo;
 	textureInfo.m_commandBuffer = m_mainCommandBuffer;
 	textureInfo.m_queue = m_graphicsQueue;
 	textureInfo.m_logicalDevice = m_device;
 	textureInfo.m_physicalDevice = m_physicalDevice;
-	textureInfo.m_layout = m_meshSetLayout[PipelineTypes::STANDARD];
+	//Gathered into the material set below instead of getting a set each
+	textureInfo.m_layout = nullptr;
 	textureInfo.m_descriptorPool = m_meshDescriptorPool;
+	textureInfo.m_uploadMutex = &uploadMutex;
 
-	for (const auto& [object, filename] : filenames)
+	//Every slot of the material array gets a texture, mesh types without one of their own get the blank one
+	std::array<vkImage::Texture*, MeshTypeCount> textures{};
+	for (uint32_t i = 0; i < MeshTypeCount; ++i)
 	{
-		textureInfo.m_filenames = filename;
-		m_materials[object] = new vkImage::Texture(textureInfo);
+		auto filename = filenames.find(static_cast<MeshTypes>(i));
+
+		vkImage::TextureInputChunk materialInfo = textureInfo;
+		materialInfo.m_filenames = filename != filenames.end() ? filename->second : std::vector<const char*>{ "./textures/none.png" };
+		loads.push_back(m_jobs->Schedule([&textures, i, materialInfo]()
+			{
+				textures[i] = new vkImage::Texture(materialInfo);
+			}));
 	}
 
-	textureInfo.m_layout = m_meshSetLayout[PipelineTypes::SKY];
-	textureInfo.m_descriptorPool = m_meshDescriptorPool;
-	textureInfo.m_filenames =
+	vkImage::TextureInputChunk skyInfo = textureInfo;
+	skyInfo.m_layout = m_meshSetLayout[PipelineTypes::SKY];
+	skyInfo.m_filenames =
 	{ {
 		"./textures/sky_front.png",  //x+
 		"./textures/sky_back.png",   //x-
@@ -355,35 +642,106 @@ void Engine::CreateAssets()
 		"./textures/sky_bottom.png", //z+
 		"./textures/sky_top.png",    //z-
 	} };
+	loads.push_back(m_jobs->Schedule([this, skyInfo]() { m_cubeMap = new vkImage::CubeMap(skyInfo); }));
+
+	//Helps with the loads, and only rethrows once none of them still refers to the locals above
+	m_jobs->Wait(loads);
+
+	for (uint32_t i = 0; i < MeshTypeCount; ++i)
+	{
+		m_materials[static_cast<MeshTypes>(i)] = textures[i];
+	}
 
-	m_cubeMap = new vkImage::CubeMap(textureInfo);
+	m_meshDraws.resize(MeshTypeCount);
+	for (const auto& [meshType, indexCount] : m_meshes->m_indexCounts)
+	{
+		vk::DrawIndexedIndirectCommand& draw = m_meshDraws[static_cast<uint32_t>(meshType)];
+		draw.indexCount = indexCount;
+		draw.instanceCount = 0;
+		draw.firstIndex = m_meshes->m_firstIndices[meshType];
+		draw.vertexOffset = 0;
+		draw.firstInstance = 0;
+	}
+
+	//Material slot of each mesh type, read per draw in the vertex shader
+	std::vector<uint32_t> drawData(MeshTypeCount);
+	for (uint32_t i = 0; i < MeshTypeCount; ++i)
+	{
+		drawData[i] = i;
+	}
+
+	BufferInputChunk input;
+	input.m_logicalDevice = m_device;
+	input.m_physicalDevice = m_physicalDevice;
+	input.m_memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	input.m_size = drawData.size() * sizeof(uint32_t);
+	input.m_usage = vk::BufferUsageFlagBits::eStorageBuffer;
+	m_drawDataBuffer = vkUtil::CreateBuffer(input);
+
+	void* drawDataWriteLocation = m_device.mapMemory(m_drawDataBuffer.m_bufferMemory, 0, input.m_size);
+	memcpy(drawDataWriteLocation, drawData.data(), input.m_size);
+	m_device.unmapMemory(m_drawDataBuffer.m_bufferMemory);
+
+	m_materialDescriptorSet = vkInit::AllocateDescriptorSet(m_device, m_meshDescriptorPool, m_meshSetLayout[PipelineTypes::STANDARD]);
+
+	std::vector<vk::DescriptorImageInfo> imageDescriptors(MeshTypeCount);
+	for (const auto& [object, material] : m_materials)
+	{
+		imageDescriptors[static_cast<uint32_t>(object)] = material->GetImageDescriptor();
+	}
+
+	vk::DescriptorBufferInfo drawDataDescriptor;
+	drawDataDescriptor.buffer = m_drawDataBuffer.m_buffer;
+	drawDataDescriptor.offset = 0;
+	drawDataDescriptor.range = input.m_size;
+
+	std::array<vk::WriteDescriptorSet, 2> materialWrites;
+	materialWrites[0].dstSet = m_materialDescriptorSet;
+	materialWrites[0].dstBinding = 0;
+	materialWrites[0].dstArrayElement = 0;
+	materialWrites[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	materialWrites[0].descriptorCount = MeshTypeCount;
+	materialWrites[0].pImageInfo = imageDescriptors.data();
+
+	materialWrites[1].dstSet = m_materialDescriptorSet;
+	materialWrites[1].dstBinding = 1;
+	materialWrites[1].dstArrayElement = 0;
+	materialWrites[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+	materialWrites[1].descriptorCount = 1;
+	materialWrites[1].pBufferInfo = &drawDataDescriptor;
+
+	m_device.updateDescriptorSets(materialWrites, nullptr);
 }
 
 
-void Engine::PrepareScene(vk::CommandBuffer commandBuffer)
+void Engine::PrepareScene(vk::CommandBuffer commandBuffer, vkUtil::RenderStats& stats)
 {
 	vk::Buffer vertexBuffers[] = { m_meshes->m_vertexBuffer.m_buffer };
 	vk::DeviceSize offsets[] = { 0 };
 	commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
 	commandBuffer.bindIndexBuffer(m_meshes->m_indexBuffer.m_buffer, 0, vk::IndexType::eUint32);
+	++stats.m_vertexBufferBinds;
+	++stats.m_indexBufferBinds;
 }
 
-void Engine::PrepareFrame(uint32_t imageIndex, Scene* scene)
+void Engine::PrepareFrame(uint32_t frameIndex, Scene* scene)
 {
-	vkUtil::SwapChainFrame& frame = m_swapChainFrames[imageIndex];
+	vkUtil::CpuZone zone("PrepareFrame");
 
-	glm::vec4 camVecForward = { 1.0f, 0.0f, 0.0f, 0.0f };
-	glm::vec4 camVecRight = { 0.0f, -1.0f, 0.0f, 0.0f };
-	glm::vec4 camVecUp = { 0.0f, 0.0f, 1.0f, 0.0f };
-	frame.cameraVectorData.m_forward = camVecForward;
-	frame.cameraVectorData.m_right = camVecRight;
-	frame.cameraVectorData.m_up = camVecUp;
-	memcpy(frame.cameraVectorWriteLocation, &(frame.cameraVectorData), sizeof(vkUtil::CameraVectors));
+	vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
 
-	// TODO: Shift to a camera class
-	glm::vec3 eye = { -1.0f, 0.0f, 5.0f };
-	glm::vec3 center = { 1.0f, 0.0f, 5.0f };
+	glm::vec3 eye = scene->GetCameraEye();
+	glm::vec3 center = scene->GetCameraTarget();
 	glm::vec3 up = { 0.0f, 0.0f, 1.0f };
+
+	//Basis for the sky, matching the view matrix below
+	glm::vec3 forward = glm::normalize(center - eye);
+	glm::vec3 right = glm::normalize(glm::cross(forward, up));
+	frame.cameraVectorData.m_forward = glm::vec4(forward, 0.0f);
+	frame.cameraVectorData.m_right = glm::vec4(right, 0.0f);
+	frame.cameraVectorData.m_up = glm::vec4(glm::cross(right, forward), 0.0f);
+	memcpy(frame.cameraVectorWriteLocation, &(frame.cameraVectorData), sizeof(vkUtil::CameraVectors));
+
 	glm::mat4 view = glm::lookAt(eye, center, up);
 	glm::mat4 projection = glm::perspective(glm::radians(45.f), static_cast<float>(m_swapChainExtent.width) / static_cast<float>(m_swapChainExtent.height), 0.1f, 100.f);
 
@@ -393,26 +751,239 @@ void Engine::PrepareFrame(uint32_t imageIndex, Scene* scene)
 	frame.cameraMatrixData.m_projection = projection;
 	frame.cameraMatrixData.m_viewProjection = projection * view;
 	memcpy(frame.cameraMatrixWriteLocation, &(frame.cameraMatrixData), sizeof(vkUtil::CameraMatrices));
+	m_renderStats.m_mappedBytesWritten += sizeof(vkUtil::CameraVectors) + sizeof(vkUtil::CameraMatrices);
+
+	//One indirect draw per mesh type, mesh types without instances draw nothing
+	std::copy(m_meshDraws.begin(), m_meshDraws.end(), frame.drawCommands.begin());
+
+	vkUtil::Frustum frustum = vkUtil::ExtractFrustum(frame.cameraMatrixData.m_viewProjection);
+
+	//CPU culling only reads the scene, so it runs alongside the transform upload
+	vkUtil::RenderStats cullStats;
+	vkUtil::JobHandle culling;
+	if (!m_gpuCulling)
+		culling = ScheduleCpuCulling(frameIndex, scene, frustum, cullStats);
+
+	UploadTransforms(frameIndex, scene);
+
+	if (m_gpuCulling)
+	{
+		//The compute pass fills in the instance counts
+		for (uint32_t meshIndex = 0; meshIndex < MeshTypeCount; ++meshIndex)
+		{
+			MeshRange range = scene->GetMeshRange(static_cast<MeshTypes>(meshIndex));
+			frame.drawCommands[meshIndex].firstInstance = range.m_first;
+
+			//Survivors are only known on the GPU, count what goes into culling
+			m_renderStats.m_instances += range.m_count;
+			m_renderStats.m_triangles += static_cast<uint64_t>(range.m_count) * (m_meshDraws[meshIndex].indexCount / 3);
+		}
+
+		std::copy(std::begin(frustum.m_planes), std::end(frustum.m_planes), std::begin(frame.cullParameters.m_planes));
+		frame.cullParameters.m_instanceCount = scene->GetInstanceCount();
+	}
+	else
+	{
+		m_jobs->Wait(culling);
+		m_renderStats += cullStats;
+	}
+}
+
+vkUtil::JobHandle Engine::ScheduleCpuCulling(uint32_t frameIndex, Scene* scene, const vkUtil::Frustum& frustum, vkUtil::RenderStats& stats)
+{
+	//Chunks never span mesh types, and come out in slot order
+	m_cullChunks.clear();
+	for (uint32_t meshIndex = 0; meshIndex < MeshTypeCount; ++meshIndex)
+	{
+		MeshRange range = scene->GetMeshRange(static_cast<MeshTypes>(meshIndex));
+		for (uint32_t first = range.m_first; first < range.m_first + range.m_count; first += m_cullChunkSize)
+		{
+			CullChunk chunk;
+			chunk.m_meshIndex = meshIndex;
+			chunk.m_first = first;
+			chunk.m_count = std::min(m_cullChunkSize, range.m_first + range.m_count - first);
+			chunk.m_visibleCount = 0;
+			m_cullChunks.push_back(chunk);
+		}
+	}
+
+	if (m_visibleIndices.size() < scene->GetInstanceCount())
+		m_visibleIndices.resize(scene->GetInstanceCount());
+
+	std::vector<vkUtil::JobHandle> chunkJobs;
+	chunkJobs.reserve(m_cullChunks.size());
+	for (uint32_t chunkIndex = 0; chunkIndex < m_cullChunks.size(); ++chunkIndex)
+	{
+		chunkJobs.push_back(m_jobs->Schedule([this, scene, frustum, chunkIndex]()
+			{
+				//A mesh type's instances are contiguous, so culling streams straight through them
+				CullChunk& chunk = m_cullChunks[chunkIndex];
+				const vkUtil::MeshBounds& bounds = m_meshes->m_bounds.at(static_cast<MeshTypes>(chunk.m_meshIndex));
+				chunk.m_visibleCount = vkUtil::CullSpheres(frustum, scene->GetPositions() + chunk.m_first, scene->GetRotations() + chunk.m_first,
+					scene->GetScales() + chunk.m_first, chunk.m_count, bounds, m_visibleIndices.data() + chunk.m_first);
+			}));
+	}
+
+	//Pack the survivors' indices per draw, in chunk order so the result doesn't depend on scheduling
+	return m_jobs->Schedule([this, frameIndex, &stats]()
+		{
+			vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+			uint32_t* visibleIndices = static_cast<uint32_t*>(frame.visibleIndexWriteLocation);
+			uint32_t visibleTotal = 0;
+
+			size_t chunkIndex = 0;
+			for (uint32_t meshIndex = 0; meshIndex < MeshTypeCount; ++meshIndex)
+			{
+				vk::DrawIndexedIndirectCommand& command = frame.drawCommands[meshIndex];
+				command.firstInstance = visibleTotal;
+
+				for (; chunkIndex < m_cullChunks.size() && m_cullChunks[chunkIndex].m_meshIndex == meshIndex; ++chunkIndex)
+				{
+					const CullChunk& chunk = m_cullChunks[chunkIndex];
+					for (uint32_t j = 0; j < chunk.m_visibleCount; ++j)
+					{
+						visibleIndices[visibleTotal++] = chunk.m_first + m_visibleIndices[chunk.m_first + j];
+					}
+				}
+
+				command.instanceCount = visibleTotal - command.firstInstance;
+				stats.m_instances += command.instanceCount;
+				stats.m_triangles += static_cast<uint64_t>(command.instanceCount) * (command.indexCount / 3);
+			}
+
+			memcpy(frame.drawCommandWriteLocation, frame.drawCommands.data(), frame.drawCommands.size() * sizeof(vk::DrawIndexedIndirectCommand));
+			stats.m_mappedBytesWritten += visibleTotal * sizeof(uint32_t) + frame.drawCommands.size() * sizeof(vk::DrawIndexedIndirectCommand);
+		}, chunkJobs);
+}
+
+void Engine::UploadTransforms(uint32_t frameIndex, Scene* scene)
+{
+	vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+	vkUtil::InstanceData* instances = static_cast<vkUtil::InstanceData*>(frame.instanceWriteLocation);
+	frame.transformUploadCount = 0;
+
+	const uint32_t* changes = nullptr;
+	uint32_t changeCount = 0;
+	bool rewriteAll = frame.instanceLayoutVersion != scene->GetLayoutVersion()
+		|| !scene->GetChangesSince(frame.transformCursor, changes, changeCount)
+		|| changeCount >= scene->GetInstanceCount();
+
+	const glm::vec3* positions = scene->GetPositions();
+	const glm::quat* rotations = scene->GetRotations();
+	const glm::vec3* scales = scene->GetScales();
+
+	//Only the changed instances' model matrices are expanded again, unless everything is rewritten
+	frame.instanceExpandAll = rewriteAll;
+	if (rewriteAll)
+	{
+		frame.instanceExpandCount = scene->GetInstanceCount();
+	}
+	else
+	{
+		//The change list is both the direct writes' and the scatter's slots
+		memcpy(frame.expandSlotWriteLocation, changes, changeCount * sizeof(uint32_t));
+		frame.instanceExpandCount = changeCount;
+		m_renderStats.m_mappedBytesWritten += changeCount * sizeof(uint32_t);
+	}
+
+	if (rewriteAll)
+	{
+		//Every instance keeps a stable slot in the instance buffer, culling only produces indices into it
+		uint32_t* meshIndices = static_cast<uint32_t*>(frame.meshIndexWriteLocation);
+		const MeshTypes* meshes = scene->GetMeshes();
+		uint32_t instanceCount = scene->GetInstanceCount();
+
+		//Records are packed straight into the mapped buffer, in contiguous chunks per thread
+		auto writeSlots = [&](uint32_t first, uint32_t count)
+			{
+				vkUtil::PackInstances(positions + first, rotations + first, scales + first, count, instances + first);
+				for (uint32_t slot = first; slot < first + count; ++slot)
+				{
+					meshIndices[slot] = static_cast<uint32_t>(meshes[slot]);
+				}
+			};
+
+		if (instanceCount < m_parallelTransformThreshold)
+		{
+			writeSlots(0, instanceCount);
+		}
+		else
+		{
+			//A few chunks per thread, so threads busy elsewhere don't hold the rest up
+			uint32_t chunkCount = m_jobs->GetThreadCount() * 4;
+			uint32_t slotsPerChunk = (instanceCount + chunkCount - 1) / chunkCount;
+			m_jobs->ParallelFor(chunkCount, [&](uint32_t chunk)
+				{
+					uint32_t first = std::min(chunk * slotsPerChunk, instanceCount);
+					writeSlots(first, std::min(slotsPerChunk, instanceCount - first));
+				});
+		}
 
-	size_t i = 0;
-	for (std::pair<MeshTypes, std::vector<glm::vec3>> pair : scene->m_positions) 
+		frame.instanceLayoutVersion = scene->GetLayoutVersion();
+		m_renderStats.m_mappedBytesWritten += instanceCount * (sizeof(vkUtil::InstanceData) + sizeof(uint32_t));
+	}
+	else if (changeCount < m_transformScatterThreshold)
 	{
-		for (glm::vec3& position : pair.second) 
+		//Few changes, write them in place
+		for (uint32_t i = 0; i < changeCount; ++i)
 		{
-			frame.modelTransforms[i++] = glm::translate(glm::mat4(1.0f), position);
+			uint32_t slot = changes[i];
+			instances[slot] = vkUtil::PackInstance(positions[slot], rotations[slot], scales[slot]);
 		}
+		m_renderStats.m_mappedBytesWritten += changeCount * sizeof(vkUtil::InstanceData);
 	}
+	else
+	{
+		//Many changes, pack them contiguously and let the GPU scatter them into their slots
+		vkUtil::TransformUpload* uploads = static_cast<vkUtil::TransformUpload*>(frame.transformUploadWriteLocation);
+		for (uint32_t i = 0; i < changeCount; ++i)
+		{
+			uint32_t slot = changes[i];
+			uploads[i].m_instance = vkUtil::PackInstance(positions[slot], rotations[slot], scales[slot]);
+			uploads[i].m_slot = slot;
+		}
 
-	memcpy(frame.modelBufferWriteLocation, frame.modelTransforms.data(),i * sizeof(glm::mat4));
+		frame.transformUploadCount = changeCount;
+		m_renderStats.m_mappedBytesWritten += changeCount * sizeof(vkUtil::TransformUpload);
+	}
+
+	frame.transformCursor = scene->GetChangeCursor();
 
-	frame.WriteDescriptorSet();
+	//Frames still on an older layout rewrite everything anyway, so they don't hold changes back
+	uint64_t oldestCursor = frame.transformCursor;
+	for (const vkUtil::SwapChainFrame& other : m_frames)
+	{
+		if (other.instanceLayoutVersion == scene->GetLayoutVersion())
+			oldestCursor = std::min(oldestCursor, other.transformCursor);
+	}
+	scene->TrimChanges(oldestCursor);
+}
+
+void Engine::RecordViewportState(vk::CommandBuffer commandBuffer)
+{
+	vk::Viewport viewport;
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(m_swapChainExtent.width);
+	viewport.height = static_cast<float>(m_swapChainExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	commandBuffer.setViewport(0, viewport);
+
+	vk::Rect2D scissor;
+	scissor.offset.x = 0;
+	scissor.offset.y = 0;
+	scissor.extent = m_swapChainExtent;
+	commandBuffer.setScissor(0, scissor);
 }
 
-void Engine::RecordDrawCommandsSky(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene)
+void Engine::RecordDrawCommandsSky(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, Scene* scene)
 {
+	vkUtil::GpuZone gpuZone(*m_gpuProfiler, commandBuffer, frameIndex, "Sky");
+
 	vk::RenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.renderPass = m_renderPass[PipelineTypes::SKY];
-	renderPassInfo.framebuffer = m_swapChainFrames[imageIndex].framebuffer[PipelineTypes::SKY];
+	renderPassInfo.framebuffer = m_swapChainImages[imageIndex].framebuffer[PipelineTypes::SKY];
 	renderPassInfo.renderArea.offset.x = 0;
 	renderPassInfo.renderArea.offset.y = 0;
 	renderPassInfo.renderArea.extent = m_swapChainExtent;
@@ -425,20 +996,32 @@ void Engine::RecordDrawCommandsSky(vk::CommandBuffer commandBuffer, uint32_t ima
 	renderPassInfo.pClearValues = clearValues.data();
 
 	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline[PipelineTypes::SKY]);
-	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout[PipelineTypes::SKY], 0, m_swapChainFrames[imageIndex].descriptorSet[PipelineTypes::SKY], nullptr);
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GetPipeline(PipelineTypes::SKY));
+	RecordViewportState(commandBuffer);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout[PipelineTypes::SKY], 0, m_frames[frameIndex].descriptorSet[PipelineTypes::SKY], nullptr);
 
 	m_cubeMap->Use(commandBuffer, m_pipelineLayout[PipelineTypes::SKY]);
 	commandBuffer.draw(6, 1, 0, 0);
 
 	commandBuffer.endRenderPass();
+
+	//A single full screen quad
+	++m_renderStats.m_renderPasses;
+	++m_renderStats.m_pipelineBinds;
+	m_renderStats.m_descriptorSetBinds += 2;
+	++m_renderStats.m_drawCalls;
+	++m_renderStats.m_draws;
+	++m_renderStats.m_instances;
+	m_renderStats.m_triangles += 2;
 }
 
-void Engine::RecordDrawCommandsScene(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene) 
+void Engine::RecordDrawCommandsScene(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, Scene* scene) 
 {
+	vkUtil::GpuZone gpuZone(*m_gpuProfiler, commandBuffer, frameIndex, "Scene");
+
 	vk::RenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.renderPass = m_renderPass[PipelineTypes::STANDARD];
-	renderPassInfo.framebuffer = m_swapChainFrames[imageIndex].framebuffer[PipelineTypes::STANDARD];
+	renderPassInfo.framebuffer = m_swapChainImages[imageIndex].framebuffer[PipelineTypes::STANDARD];
 	renderPassInfo.renderArea.offset.x = 0;
 	renderPassInfo.renderArea.offset.y = 0;
 	renderPassInfo.renderArea.extent = m_swapChainExtent;
@@ -453,109 +1036,441 @@ void Engine::RecordDrawCommandsScene(vk::CommandBuffer commandBuffer, uint32_t i
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline[PipelineTypes::STANDARD]);
-	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout[PipelineTypes::STANDARD], 0, m_swapChainFrames[imageIndex].descriptorSet[PipelineTypes::STANDARD], nullptr);
-
-	PrepareScene(commandBuffer);
+	//Only worth splitting with enough draws to cover every worker's setup
+	uint32_t drawCount = static_cast<uint32_t>(m_frames[frameIndex].drawCommands.size());
+	uint32_t workerCount = std::min(drawCount / std::max(m_minDrawsPerWorker, 1u), m_jobs->GetThreadCount());
 
-	uint32_t startInstance = 0;
-
-	for (std::pair<MeshTypes, std::vector<glm::vec3>> pair : scene->m_positions)
+	if (workerCount <= 1)
 	{
-		RenderObjects(commandBuffer, pair.first, startInstance, static_cast<uint32_t>(pair.second.size()));
+		commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
+		RecordSceneDraws(commandBuffer, frameIndex, 0, drawCount, m_renderStats);
+		commandBuffer.endRenderPass();
+
+		++m_renderStats.m_renderPasses;
+		return;
 	}
 
+	commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+
+	//Split the draws evenly, every worker records its share into its own secondary command buffer
+	uint32_t drawsPerWorker = (drawCount + workerCount - 1) / workerCount;
+	workerCount = (drawCount + drawsPerWorker - 1) / drawsPerWorker;
+
+	//Made the first time a frame splits this many ways, most scenes never do
+	vkInit::CreateFrameWorkerCommandBuffers(m_device, m_physicalDevice, m_surface, m_frames[frameIndex], workerCount, m_debugMode);
+
+	m_workerRenderStats.assign(workerCount, vkUtil::RenderStats());
+	m_jobs->ParallelFor(workerCount, [&](uint32_t worker)
+		{
+			uint32_t firstDraw = worker * drawsPerWorker;
+			RecordSceneWorker(frameIndex, imageIndex, worker, firstDraw, std::min(drawsPerWorker, drawCount - firstDraw), m_workerRenderStats[worker]);
+		});
+
+	commandBuffer.executeCommands(workerCount, m_frames[frameIndex].workerCommandBuffers.data());
+
 	commandBuffer.endRenderPass();
+
+	++m_renderStats.m_renderPasses;
+	for (const vkUtil::RenderStats& workerStats : m_workerRenderStats)
+	{
+		m_renderStats += workerStats;
+	}
 }
 
-void Engine::RenderObjects(vk::CommandBuffer commandBuffer, MeshTypes objectType, uint32_t& startInstance, uint32_t instanceCount)
+void Engine::RecordSceneWorker(uint32_t frameIndex, uint32_t imageIndex, uint32_t worker, uint32_t firstDraw, uint32_t drawCount, vkUtil::RenderStats& stats)
 {
-	int indexCount = m_meshes->m_indexCounts.find(objectType)->second;
-	int firstIndex = m_meshes->m_firstIndices.find(objectType)->second;
-	m_materials[objectType]->Use(commandBuffer, m_pipelineLayout[PipelineTypes::STANDARD]);
-	commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, 0, startInstance);
-	startInstance += instanceCount;
-}
+	//Runs on a worker thread, so only const lookups into shared state
+	vkUtil::CpuZone zone("RecordSceneWorker");
+	vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+	vk::CommandBuffer commandBuffer = frame.workerCommandBuffers[worker];
 
+	m_device.resetCommandPool(frame.workerCommandPools[worker]);
 
-void Engine::Render(Scene* scene)
-{
-	static_cast<void>(m_device.waitForFences(1, &(m_swapChainFrames[m_frameNumber].inFlight), VK_TRUE, UINT64_MAX));
-	static_cast<void>(m_device.resetFences(1, &(m_swapChainFrames[m_frameNumber].inFlight)));
-	//acquireNextImageKHR(vk::SwapChainKHR, timeout, semaphore_to_signal, fence)
-	uint32_t imageIndex = 0;
-	try 
+	vk::CommandBufferInheritanceInfo inheritanceInfo;
+	inheritanceInfo.renderPass = m_renderPass.at(PipelineTypes::STANDARD);
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = m_swapChainImages[imageIndex].framebuffer.at(PipelineTypes::STANDARD);
+
+	vk::CommandBufferBeginInfo beginInfo;
+	beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	try
 	{
-		vk::ResultValue acquire = m_device.acquireNextImageKHR(m_swapChain, UINT64_MAX, m_swapChainFrames[m_frameNumber].imageAvailable, nullptr);
-		imageIndex = acquire.value;
+		commandBuffer.begin(beginInfo);
 	}
-	catch (vk::OutOfDateKHRError error)
+	catch (vk::SystemError err)
 	{
-		RecreateSwapChain();
-		return;
+		if (m_debugMode)
+			std::cout << "Failed to begin recording worker command buffer!" << std::endl;
 	}
-	catch (vk::IncompatibleDisplayKHRError error) 
+
+	RecordSceneDraws(commandBuffer, frameIndex, firstDraw, drawCount, stats);
+
+	try
 	{
-		RecreateSwapChain();
+		commandBuffer.end();
+	}
+	catch (vk::SystemError err)
+	{
+		if (m_debugMode)
+			std::cout << "Failed to record worker command buffer!" << std::endl;
+	}
+}
+
+void Engine::RecordSceneDraws(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t firstDraw, uint32_t drawCount, vkUtil::RenderStats& stats)
+{
+	if (drawCount == 0)
 		return;
+
+	const vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+	vk::PipelineLayout layout = m_pipelineLayout.at(PipelineTypes::STANDARD);
+
+	//Binds all state itself, secondary command buffers inherit none from the primary, dynamic state included
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, GetPipeline(PipelineTypes::STANDARD));
+	RecordViewportState(commandBuffer);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, frame.descriptorSet.at(PipelineTypes::STANDARD), nullptr);
+
+	PrepareScene(commandBuffer, stats);
+
+	//Materials are selected per draw in the shaders, so nothing is bound between draws
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 1, m_materialDescriptorSet, nullptr);
+
+	++stats.m_pipelineBinds;
+	stats.m_descriptorSetBinds += 2;
+	stats.m_draws += drawCount;
+
+	//Written by the culling pass or by PrepareFrame
+	vk::Buffer drawCommandBuffer = frame.drawCommandBuffer.m_buffer;
+	uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+
+	if (m_multiDrawIndirect)
+	{
+		commandBuffer.drawIndexedIndirect(drawCommandBuffer, firstDraw * stride, drawCount, stride);
+		++stats.m_drawCalls;
+	}
+	else
+	{
+		for (uint32_t i = firstDraw; i < firstDraw + drawCount; ++i)
+		{
+			commandBuffer.drawIndexedIndirect(drawCommandBuffer, i * stride, 1, stride);
+		}
+		stats.m_drawCalls += drawCount;
 	}
-	catch (vk::SystemError error) 
+}
+
+void Engine::RecordScatterPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	vkUtil::GpuZone gpuZone(*m_gpuProfiler, commandBuffer, frameIndex, "Transform scatter");
+
+	vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+
+	vkUtil::ScatterParameters parameters;
+	parameters.m_uploadCount = frame.transformUploadCount;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_scatterPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_scatterPipelineLayout, 0, frame.scatterDescriptorSet, nullptr);
+	commandBuffer.pushConstants(m_scatterPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(vkUtil::ScatterParameters), &parameters);
+
+	//64 invocations per workgroup, see scatter.comp
+	commandBuffer.dispatch((parameters.m_uploadCount + 63) / 64, 1, 1);
+
+	++m_renderStats.m_pipelineBinds;
+	++m_renderStats.m_descriptorSetBinds;
+	++m_renderStats.m_dispatches;
+
+	//Instances must land before they are expanded
+	vk::BufferMemoryBarrier scatterBarrier;
+	scatterBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	scatterBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	scatterBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	scatterBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	scatterBarrier.buffer = frame.instanceBuffer.m_buffer;
+	scatterBarrier.offset = 0;
+	scatterBarrier.size = VK_WHOLE_SIZE;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+		vk::DependencyFlags(), nullptr, scatterBarrier, nullptr);
+}
+
+void Engine::RecordExpandPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	vkUtil::GpuZone gpuZone(*m_gpuProfiler, commandBuffer, frameIndex, "Instance expansion");
+
+	vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+
+	vkUtil::ExpandParameters parameters;
+	parameters.m_instanceCount = frame.instanceExpandCount;
+	parameters.m_useSlots = frame.instanceExpandAll ? 0 : 1;
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_expandPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_expandPipelineLayout, 0, frame.expandDescriptorSet, nullptr);
+	commandBuffer.pushConstants(m_expandPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(vkUtil::ExpandParameters), &parameters);
+
+	//64 invocations per workgroup, see expand.comp
+	commandBuffer.dispatch((parameters.m_instanceCount + 63) / 64, 1, 1);
+
+	++m_renderStats.m_pipelineBinds;
+	++m_renderStats.m_descriptorSetBinds;
+	++m_renderStats.m_dispatches;
+
+	//Transforms must land before culling and drawing read them
+	vk::BufferMemoryBarrier expandBarrier;
+	expandBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	expandBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	expandBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	expandBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	expandBarrier.buffer = frame.modelBuffer.m_buffer;
+	expandBarrier.offset = 0;
+	expandBarrier.size = VK_WHOLE_SIZE;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+		vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader,
+		vk::DependencyFlags(), nullptr, expandBarrier, nullptr);
+}
+
+void Engine::RecordCullingPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	vkUtil::GpuZone gpuZone(*m_gpuProfiler, commandBuffer, frameIndex, "Culling");
+
+	vkUtil::SwapChainFrame& frame = m_frames[frameIndex];
+
+	//Reset the draws, instance counts start at zero
+	vk::DeviceSize drawCommandSize = frame.drawCommands.size() * sizeof(vk::DrawIndexedIndirectCommand);
+	commandBuffer.updateBuffer(frame.drawCommandBuffer.m_buffer, 0, drawCommandSize, frame.drawCommands.data());
+	m_renderStats.m_bufferUpdateBytes += drawCommandSize;
+
+	vk::BufferMemoryBarrier resetBarrier;
+	resetBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	resetBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+	resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	resetBarrier.buffer = frame.drawCommandBuffer.m_buffer;
+	resetBarrier.offset = 0;
+	resetBarrier.size = VK_WHOLE_SIZE;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+		vk::DependencyFlags(), nullptr, resetBarrier, nullptr);
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_cullPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_cullPipelineLayout, 0, frame.cullDescriptorSet, nullptr);
+	commandBuffer.pushConstants(m_cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(vkUtil::CullParameters), &frame.cullParameters);
+
+	//64 invocations per workgroup, see cull.comp
+	uint32_t groupCount = (frame.cullParameters.m_instanceCount + 63) / 64;
+	if (groupCount > 0)
 	{
-		std::cout << "Failed to acquire swapchain image!" << std::endl;
+		commandBuffer.dispatch(groupCount, 1, 1);
+		++m_renderStats.m_dispatches;
 	}
+	++m_renderStats.m_pipelineBinds;
+	++m_renderStats.m_descriptorSetBinds;
+
+	//Draws and visible indices must land before they are consumed
+	std::array<vk::BufferMemoryBarrier, 2> cullBarriers;
+	cullBarriers[0] = resetBarrier;
+	cullBarriers[0].srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	cullBarriers[0].dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead;
+	cullBarriers[1] = cullBarriers[0];
+	cullBarriers[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	cullBarriers[1].buffer = frame.visibleIndexBuffer.m_buffer;
+	commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+		vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader,
+		vk::DependencyFlags(), nullptr, cullBarriers, nullptr);
+}
 
-	vk::CommandBuffer commandBuffer = m_swapChainFrames[m_frameNumber].commandBuffer;
+void Engine::SetPresentMode(vk::PresentModeKHR presentMode)
+{
+	m_requestedPresentMode = presentMode;
+	if (!m_headless)
+		RecreateSwapChain();
+}
 
-	commandBuffer.reset();
+vk::PresentModeKHR Engine::GetPresentMode() const
+{
+	return m_presentMode;
+}
 
-	PrepareFrame(imageIndex, scene);
+const std::vector<vk::PresentModeKHR>& Engine::GetSupportedPresentModes() const
+{
+	return m_supportedPresentModes;
+}
 
-	vk::CommandBufferBeginInfo beginInfo{};
+void Engine::SetFrameRateCap(double framesPerSecond)
+{
+	m_framePacer.SetTargetFrameRate(framesPerSecond);
+}
+
+void Engine::SetLowLatencyMode(bool lowLatency)
+{
+	m_lowLatency = lowLatency;
+}
+
+void Engine::SetMinDrawsPerWorker(uint32_t minDrawsPerWorker)
+{
+	m_minDrawsPerWorker = std::max(minDrawsPerWorker, 1u);
+}
+
+const vkUtil::FramePacer& Engine::GetFramePacer() const
+{
+	return m_framePacer;
+}
+
+const vkUtil::FrameStats& Engine::GetFrameStats() const
+{
+	return m_frameStats;
+}
+
+void Engine::Render(Scene* scene)
+{
+	vkUtil::CpuZone frameZone("Frame");
 
-	try
 	{
-		commandBuffer.begin(beginInfo);
+		vkUtil::CpuZone zone("Pacer wait");
+		m_framePacer.WaitForNextFrame();
 	}
-	catch (vk::SystemError err)
+	m_frameStats.BeginFrame();
+
+	//Input was polled by the caller just before
+	if (!m_lowLatency)
+		m_framePacer.MarkInputSampled();
+
+	//Resources of this ring slot are free once its previous submission finished
+	vkUtil::SwapChainFrame& frame = m_frames[m_frameNumber];
 	{
-		if (m_debugMode)
-			std::cout << "Failed to begin recording command buffer!" << std::endl;
+		vkUtil::CpuZone zone("Fence wait");
+		auto waitStart = vkUtil::FrameStats::Clock::now();
+		static_cast<void>(m_device.waitForFences(1, &(frame.inFlight), VK_TRUE, UINT64_MAX));
+		m_frameStats.AddFenceWait(vkUtil::FrameStats::Clock::now() - waitStart);
 	}
+	m_completedSerial = std::max(m_completedSerial, frame.submissionSerial);
+
+	if (m_lowLatency)
+	{
+		//Drain the other frames too, then sample input as late as possible before acquiring
+		{
+			vkUtil::CpuZone zone("Fence wait (low latency)");
+			auto waitStart = vkUtil::FrameStats::Clock::now();
+			static_cast<void>(m_device.waitForFences(m_inFlightFences, VK_TRUE, UINT64_MAX));
+			m_frameStats.AddFenceWait(vkUtil::FrameStats::Clock::now() - waitStart);
+		}
+		m_completedSerial = m_submittedSerial;
 
-	RecordDrawCommandsSky(commandBuffer, imageIndex, scene);
-	RecordDrawCommandsScene(commandBuffer, imageIndex, scene);
+		if (!m_headless)
+			glfwPollEvents();
+		m_framePacer.MarkInputSampled();
+	}
 
-	try
 	{
-		commandBuffer.end();
+		vkUtil::CpuZone zone("Deferred deletion");
+		m_deletionQueue.Flush(m_completedSerial);
 	}
-	catch (vk::SystemError err)
+
+	//Grow this slot's instance buffers while its fence is still signalled, descriptor sets only change then
+	frame.ReserveInstances(scene->GetInstanceCount());
+
+	//Swap in any pipelines which finished compiling in the background
+	CollectPipelines(false);
+
+	//Headless, each frame in flight renders into its own offscreen target
+	uint32_t imageIndex = m_frameNumber;
+	if (!m_headless)
 	{
-		if (m_debugMode)
+		vkUtil::CpuZone zone("Acquire");
+
+		//acquireNextImageKHR(vk::SwapChainKHR, timeout, semaphore_to_signal, fence)
+		try 
+		{
+			vk::ResultValue acquire = m_device.acquireNextImageKHR(m_swapChain, UINT64_MAX, frame.imageAvailable, nullptr);
+			imageIndex = acquire.value;
+		}
+		catch (vk::OutOfDateKHRError error)
 		{
-			std::cout << "Failed to record command buffer!" << std::endl;
+			RecreateSwapChain();
+			return;
+		}
+		catch (vk::IncompatibleDisplayKHRError error) 
+		{
+			RecreateSwapChain();
+			return;
+		}
+		catch (vk::SystemError error) 
+		{
+			std::cout << "Failed to acquire swapchain image!" << std::endl;
+		}
+	}
+
+	//Only reset once work is certain to be submitted, or the next wait would never return
+	static_cast<void>(m_device.resetFences(1, &(frame.inFlight)));
+
+	vk::CommandBuffer commandBuffer = frame.commandBuffer;
+
+	commandBuffer.reset();
+
+	m_renderStats = vkUtil::RenderStats();
+	PrepareFrame(m_frameNumber, scene);
+
+	{
+		vkUtil::CpuZone zone("Record");
+
+		vk::CommandBufferBeginInfo beginInfo{};
+
+		try
+		{
+			commandBuffer.begin(beginInfo);
+		}
+		catch (vk::SystemError err)
+		{
+			if (m_debugMode)
+				std::cout << "Failed to begin recording command buffer!" << std::endl;
+		}
+
+		m_gpuProfiler->BeginFrame(commandBuffer, m_frameNumber);
+
+		if (frame.transformUploadCount > 0)
+			RecordScatterPass(commandBuffer, m_frameNumber);
+
+		if (frame.instanceExpandCount > 0)
+			RecordExpandPass(commandBuffer, m_frameNumber);
+
+		if (m_gpuCulling)
+			RecordCullingPass(commandBuffer, m_frameNumber);
+
+		RecordDrawCommandsSky(commandBuffer, m_frameNumber, imageIndex, scene);
+		RecordDrawCommandsScene(commandBuffer, m_frameNumber, imageIndex, scene);
+
+		try
+		{
+			commandBuffer.end();
+		}
+		catch (vk::SystemError err)
+		{
+			if (m_debugMode)
+			{
+				std::cout << "Failed to record command buffer!" << std::endl;
+			}
 		}
 	}
 
 	vk::SubmitInfo submitInfo{};
 
-	vk::Semaphore waitSemaphores[]{ m_swapChainFrames[m_frameNumber].imageAvailable };
+	//Without acquire and present there is nothing to wait on or signal
+	vk::Semaphore waitSemaphores[]{ frame.imageAvailable };
 	vk::PipelineStageFlags waitStages[]{ vk::PipelineStageFlagBits::eColorAttachmentOutput };
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = m_headless ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vk::Semaphore signalSemaphores[]{ m_swapChainFrames[m_frameNumber].renderFinished };
-	submitInfo.signalSemaphoreCount = 1;
+	//Per image, the present of an image is the only waiter on its semaphore
+	vk::Semaphore signalSemaphores[]{ m_swapChainImages[imageIndex].renderFinished };
+	submitInfo.signalSemaphoreCount = m_headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	try 
 	{
-		m_graphicsQueue.submit(submitInfo, m_swapChainFrames[m_frameNumber].inFlight);
+		vkUtil::CpuZone zone("Submit");
+		m_graphicsQueue.submit(submitInfo, frame.inFlight);
+		frame.submissionSerial = ++m_submittedSerial;
 	}
 	catch (vk::SystemError err) 
 	{
@@ -563,6 +1478,16 @@ void Engine::Render(Scene* scene)
 			std::cout << "failed to submit draw command buffer!" << std::endl;
 	}
 
+	m_lastImageIndex = imageIndex;
+
+	if (m_headless)
+	{
+		m_framePacer.MarkPresented();
+		m_frameStats.MarkPresented();
+		m_frameNumber = (m_frameNumber + 1) % m_maxFramesInFlight;
+		return;
+	}
+
 	vk::PresentInfoKHR presentInfo{};
 	presentInfo.waitSemaphoreCount = 1;
 	presentInfo.pWaitSemaphores = signalSemaphores;
@@ -576,6 +1501,7 @@ void Engine::Render(Scene* scene)
 	vk::Result present;
 	try
 	{
+		vkUtil::CpuZone zone("Present");
 		present = m_presentQueue.presentKHR(presentInfo);
 	}
 	catch (vk::OutOfDateKHRError error)
@@ -583,11 +1509,103 @@ void Engine::Render(Scene* scene)
 		present = vk::Result::eErrorOutOfDateKHR;
 	}
 
+	m_framePacer.MarkPresented();
+	m_frameStats.MarkPresented();
+
+	m_frameNumber = (m_frameNumber + 1) % m_maxFramesInFlight;
+
 	if (present == vk::Result::eErrorOutOfDateKHR || present == vk::Result::eSuboptimalKHR)
-	{
 		RecreateSwapChain();
-		return;
-	}
+}
 
-	m_frameNumber = (m_frameNumber + 1) % m_maxFramesInFlight;
-}
\ No newline at end of file
+std::vector<uint8_t> Engine::ReadBackFrame()
+{
+	std::vector<uint8_t> pixels;
+	if (!m_headless)
+		return pixels;
+
+	vkUtil::CpuZone zone("ReadBackFrame");
+
+	m_device.waitIdle();
+
+	vk::DeviceSize size = static_cast<vk::DeviceSize>(m_swapChainExtent.width) * m_swapChainExtent.height * 4;
+
+	BufferInputChunk input;
+	input.m_logicalDevice = m_device;
+	input.m_physicalDevice = m_physicalDevice;
+	input.m_size = size;
+	input.m_usage = vk::BufferUsageFlagBits::eTransferDst;
+	input.m_memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	Buffer readbackBuffer = vkUtil::CreateBuffer(input);
+
+	vk::Image image = m_swapChainImages[m_lastImageIndex].image;
+
+	vkUtil::StartJob(m_mainCommandBuffer);
+
+	//The frame has finished, but its writes still have to be made visible to the copy
+	vk::ImageMemoryBarrier imageBarrier;
+	imageBarrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+	imageBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+	imageBarrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+	imageBarrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = image;
+	imageBarrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+	imageBarrier.subresourceRange.baseMipLevel = 0;
+	imageBarrier.subresourceRange.levelCount = 1;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount = 1;
+	m_mainCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags(), nullptr, nullptr, imageBarrier);
+
+	vk::BufferImageCopy copy;
+	copy.bufferOffset = 0;
+	copy.bufferRowLength = 0;
+	copy.bufferImageHeight = 0;
+	copy.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+	copy.imageSubresource.mipLevel = 0;
+	copy.imageSubresource.baseArrayLayer = 0;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageOffset = vk::Offset3D(0, 0, 0);
+	copy.imageExtent = vk::Extent3D(m_swapChainExtent.width, m_swapChainExtent.height, 1);
+	m_mainCommandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, readbackBuffer.m_buffer, copy);
+
+	vk::BufferMemoryBarrier bufferBarrier;
+	bufferBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	bufferBarrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = readbackBuffer.m_buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	m_mainCommandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+		vk::DependencyFlags(), nullptr, bufferBarrier, nullptr);
+
+	vkUtil::EndJob(m_mainCommandBuffer, m_graphicsQueue);
+
+	pixels.resize(static_cast<size_t>(size));
+	void* memoryLocation = m_device.mapMemory(readbackBuffer.m_bufferMemory, 0, size);
+	std::memcpy(pixels.data(), memoryLocation, pixels.size());
+	m_device.unmapMemory(readbackBuffer.m_bufferMemory);
+
+	vkUtil::FreeMemory(m_device, readbackBuffer.m_bufferMemory);
+	m_device.destroyBuffer(readbackBuffer.m_buffer);
+
+	return pixels;
+}
+
+bool Engine::IsHeadless() const
+{
+	return m_headless;
+}
+
+const vkUtil::GpuProfiler& Engine::GetGpuProfiler() const
+{
+	return *m_gpuProfiler;
+}
+
+vkUtil::RenderStats Engine::GetRenderStats() const
+{
+	return m_renderStats;
+}
@@ -7,16 +7,98 @@
 #include "Image.h"
 #include "Texture.h"
 #include "CubeMap.h"
+#include "JobSystem.h"
+#include "FramePacer.h"
+#include "FrameStats.h"
+#include "DeletionQueue.h"
+#include "Pipeline.h"
+#include "GpuProfiler.h"
+#include "RenderStats.h"
+#include "Culling.h"
 
 class Engine 
 {
 
 public:
 
-	Engine(int width, int height, GLFWwindow* window);
+	/**
+		\param width the width of the rendered images
+		\param height the height of the rendered images
+		\param window the window to present to, nullptr to render headless into offscreen images
+		\param gpuCulling whether to cull in a compute pass, or on the CPU
+	*/
+	Engine(int width, int height, GLFWwindow* window, bool gpuCulling);
 	~Engine();
 
 	void Render(Scene* scene);
+
+	/**
+		Request a present mode, recreating the swapchain. Unsupported modes fall back to FIFO.
+
+		\param presentMode FIFO (vsync), MAILBOX (vsync, newest frame wins) or IMMEDIATE (tearing)
+	*/
+	void SetPresentMode(vk::PresentModeKHR presentMode);
+
+	vk::PresentModeKHR GetPresentMode() const;
+
+	/**
+		\returns the present modes the surface supports
+	*/
+	const std::vector<vk::PresentModeKHR>& GetSupportedPresentModes() const;
+
+	/**
+		\param framesPerSecond the frame rate cap, 0 for uncapped
+	*/
+	void SetFrameRateCap(double framesPerSecond);
+
+	/**
+		In low latency mode the CPU waits for the GPU to drain before sampling input,
+		so no frame built on older input is queued ahead of the new one.
+
+		\param lowLatency whether to enable low latency mode
+	*/
+	void SetLowLatencyMode(bool lowLatency);
+
+	/**
+		Scene draws are split across worker threads, each recording a secondary command buffer,
+		once every worker gets at least this many draws. Fewer are recorded inline.
+
+		\param minDrawsPerWorker the smallest share of draws worth a worker, at least 1
+	*/
+	void SetMinDrawsPerWorker(uint32_t minDrawsPerWorker);
+
+	/**
+		\returns frame pacing state, including the input to present latency
+	*/
+	const vkUtil::FramePacer& GetFramePacer() const;
+
+	/**
+		\returns the timings of recent frames, for percentiles and hitch counts
+	*/
+	const vkUtil::FrameStats& GetFrameStats() const;
+
+	/**
+		\returns whether the engine renders offscreen, without a window
+	*/
+	bool IsHeadless() const;
+
+	/**
+		Copy the most recently rendered frame back to the host, waiting for the device.
+		Only available headless, swapchain images can't be read back.
+
+		\returns the pixels, tightly packed rows in B8G8R8A8 order, empty when not headless
+	*/
+	std::vector<uint8_t> ReadBackFrame();
+
+	/**
+		\returns GPU time per pass, measured with timestamps a few frames behind
+	*/
+	const vkUtil::GpuProfiler& GetGpuProfiler() const;
+
+	/**
+		\returns what the renderer recorded and uploaded for the latest frame
+	*/
+	vkUtil::RenderStats GetRenderStats() const;
 private:
 
 	//whether to print debug messages in functions
@@ -31,6 +113,9 @@ private:
 	int m_height;
 	GLFWwindow* m_window{ nullptr };
 
+	//Renders into engine owned images, no surface, swapchain or present
+	bool m_headless{ false };
+
 	//instance-related variables
 	vk::Instance m_instance{ nullptr };
 	vk::DebugUtilsMessengerEXT m_debugMessenger{ nullptr };
@@ -42,10 +127,22 @@ private:
 	vk::Device m_device{ nullptr };
 	vk::Queue m_graphicsQueue{ nullptr };
 	vk::Queue m_presentQueue{ nullptr };
+	//One indirect call covers every mesh type, otherwise one indirect call per mesh type
+	bool m_multiDrawIndirect{ false };
 	vk::SwapchainKHR  m_swapChain{ nullptr };
-	std::vector<vkUtil::SwapChainFrame>  m_swapChainFrames;
+	std::vector<vkUtil::SwapChainImage> m_swapChainImages;
 	vk::Format m_swapChainFormat;
 	vk::Extent2D m_swapChainExtent;
+	//The image the latest frame rendered into
+	uint32_t m_lastImageIndex{ 0 };
+
+	//Frame pacing
+	vk::PresentModeKHR m_requestedPresentMode{ vk::PresentModeKHR::eMailbox };
+	vk::PresentModeKHR m_presentMode;
+	std::vector<vk::PresentModeKHR> m_supportedPresentModes;
+	bool m_lowLatency{ false };
+	vkUtil::FramePacer m_framePacer;
+	vkUtil::FrameStats m_frameStats;
 
 	//pipeline-related variables
 	std::vector<PipelineTypes> m_pipelineTypes = { { PipelineTypes::SKY, PipelineTypes::STANDARD } };
@@ -53,36 +150,139 @@ private:
 	std::unordered_map<PipelineTypes, vk::RenderPass> m_renderPass;
 	std::unordered_map<PipelineTypes, vk::Pipeline> m_pipeline;
 
+	//Pipelines still compiling in the background, drawn with their fallback until ready.
+	//A fallback has to share the pipeline layout and render pass, the object cache makes those the same objects.
+	std::unordered_map<PipelineTypes, vkInit::PendingGraphicsPipeline> m_pendingPipelines;
+	std::unordered_map<PipelineTypes, PipelineTypes> m_pipelineFallback;
+
+	//Compiled pipelines persist across runs, so warm starts skip most shader compilation
+	const char* m_pipelineCacheFilename{ "pipeline_cache.bin" };
+	vk::PipelineCache m_pipelineCache{ nullptr };
+
+	//Identical pipelines, layouts and renderpasses resolve to one object
+	vkInit::ObjectCache* m_objectCache{ nullptr };
+
+	//Culling runs in a compute pass which writes the indirect draws, instead of on the CPU.
+	//Fixed at construction, pipelines and descriptor pools depend on it.
+	bool m_gpuCulling;
+	vk::PipelineLayout m_cullPipelineLayout;
+	vk::Pipeline m_cullPipeline;
+
+	//Changed transforms past this count are scattered by a compute pass instead of written in place
+	uint32_t m_transformScatterThreshold{ 256 };
+	vk::PipelineLayout m_scatterPipelineLayout;
+	vk::Pipeline m_scatterPipeline;
+
+	//Turns the compact instance records into the model matrices culling and drawing read
+	vk::PipelineLayout m_expandPipelineLayout;
+	vk::Pipeline m_expandPipeline;
+
+	//Repacking every instance is split into jobs from this many instances
+	uint32_t m_parallelTransformThreshold{ 16384 };
+
 	//Command-related variables
 	vk::CommandPool m_commandPool;
 	vk::CommandBuffer m_mainCommandBuffer;
 
-	//Synchronization objects
-	int m_maxFramesInFlight, m_frameNumber;
+	//Runs pipeline compiles, asset loading, transform packing, CPU culling and scene recording in parallel.
+	//Recording gives every job its own secondary command buffer, so there are as many jobs as threads.
+	vkUtil::JobSystem* m_jobs{ nullptr };
+
+	//Scene draws are only split across secondary command buffers with at least this many per buffer,
+	//each one costs a pool reset and rebinding all state. Fewer draws are recorded inline.
+	//Debug builds split down to a single draw, so the validation layers check the secondary path too.
+	uint32_t m_minDrawsPerWorker{ m_debugMode ? 1u : 64u };
+
+	//Timestamps around every pass, logged periodically in debug mode
+	vkUtil::GpuProfiler* m_gpuProfiler{ nullptr };
+
+	//Counters of the frame being recorded, workers count into their own slot which is merged after recording
+	vkUtil::RenderStats m_renderStats;
+	std::vector<vkUtil::RenderStats> m_workerRenderStats;
+
+	//Frames in flight, a ring independent of the swapchain image count.
+	//A deeper ring trades input latency for CPU/GPU overlap.
+	int m_maxFramesInFlight{ 2 }, m_frameNumber;
+	std::vector<vkUtil::SwapChainFrame> m_frames;
+	//Every frame's inFlight fence, so low latency mode drains them all without building a list each frame
+	std::vector<vk::Fence> m_inFlightFences;
+
+	//Submissions are numbered, objects retired while in use wait in the deletion queue until theirs finished
+	uint64_t m_submittedSerial{ 0 };
+	uint64_t m_completedSerial{ 0 };
+	vkUtil::DeletionQueue m_deletionQueue;
 
 	//Descriptor objects
 	std::unordered_map<PipelineTypes, vk::DescriptorSetLayout> m_frameSetLayout;
 	vk::DescriptorPool m_frameDescriptorPool;
 	std::unordered_map<PipelineTypes, vk::DescriptorSetLayout> m_meshSetLayout;
 	vk::DescriptorPool m_meshDescriptorPool;
+	vk::DescriptorSetLayout m_cullSetLayout;
+	vk::DescriptorPool m_cullDescriptorPool;
+	vk::DescriptorSetLayout m_scatterSetLayout;
+	vk::DescriptorSetLayout m_expandSetLayout;
+	vk::DescriptorPool m_scatterDescriptorPool;
 
 	//Asset pointers
-	VertexManager* m_meshes;
+	VertexManager* m_meshes{ nullptr };
 	std::unordered_map<MeshTypes, vkImage::Texture*> m_materials;
 	vkImage::CubeMap* m_cubeMap;
 
+	//Per draw data: every material in one set, indexed through each mesh type's material slot
+	vk::DescriptorSet m_materialDescriptorSet;
+	Buffer m_drawDataBuffer;
+
+	//Index range of each mesh type, the template for the per frame indirect draws
+	std::vector<vk::DrawIndexedIndirectCommand> m_meshDraws;
+
+	//CPU culling splits each mesh type's instances into chunks of this many, culled as separate jobs
+	uint32_t m_cullChunkSize{ 4096 };
+
+	/**
+		A run of one mesh type's slots culled by one job
+	*/
+	struct CullChunk
+	{
+		uint32_t m_meshIndex;
+		uint32_t m_first;
+		uint32_t m_count;
+		uint32_t m_visibleCount;
+	};
+
+	//Culling scratch space, reused every frame. Each chunk writes the survivors it found at its own slot offset.
+	std::vector<CullChunk> m_cullChunks;
+	std::vector<uint32_t> m_visibleIndices;
+
 	//Instance setup
 	void CreateInstance();
 
 	//Device setup
 	void CreateDevice();
-	void CreateSwapChain();
+	void CreateSwapChain(vk::SwapchainKHR oldSwapChain);
 	void RecreateSwapChain();
+	void CreateOffscreenTargets();
 
 	//Pipeline setup
 	void CreateDescriptorSetLayout();
 	void CreatePipeline();
 
+	/**
+		Install pipelines which finished compiling in the background.
+
+		\param wait whether to block until every pending pipeline is built
+	*/
+	void CollectPipelines(bool wait);
+
+	/**
+		Wait for one pending pipeline and install it.
+	*/
+	void CollectPipeline(PipelineTypes pipelineType);
+
+	/**
+		\returns the pipeline to draw with, or its fallback while it is still compiling
+	*/
+	vk::Pipeline GetPipeline(PipelineTypes pipelineType) const;
+
 	//Final setup steps
 	void FinalSetup();
 	void CreateFrameBuffers();
@@ -90,11 +290,30 @@ private:
 
 	void CreateAssets();
 
-	void PrepareScene(vk::CommandBuffer commandBuffer);
-	void PrepareFrame(uint32_t imageIndex, Scene* scene);
-	void RecordDrawCommandsScene(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene);
-	void RecordDrawCommandsSky(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene);
-	void RenderObjects(vk::CommandBuffer commandBuffer, MeshTypes objectType, uint32_t& startInstance, uint32_t instanceCount);
+	void PrepareScene(vk::CommandBuffer commandBuffer, vkUtil::RenderStats& stats);
+	void PrepareFrame(uint32_t frameIndex, Scene* scene);
+	void UploadTransforms(uint32_t frameIndex, Scene* scene);
+
+	/**
+		Schedule culling of every instance on the CPU: one job per chunk, then one
+		which packs the survivors into the frame's visible indices and indirect draws.
+		Only reads the scene, so other preparation can run until the returned job is waited on.
+
+		\param frameIndex the frame whose draws are written
+		\param scene the instances to cull
+		\param frustum the camera's frustum
+		\param stats receives the drawn instances and triangles, must outlive the jobs
+		\returns the job which finishes last
+	*/
+	vkUtil::JobHandle ScheduleCpuCulling(uint32_t frameIndex, Scene* scene, const vkUtil::Frustum& frustum, vkUtil::RenderStats& stats);
+	void RecordScatterPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+	void RecordExpandPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+	void RecordCullingPass(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+	void RecordDrawCommandsScene(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, Scene* scene);
+	void RecordSceneDraws(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t firstDraw, uint32_t drawCount, vkUtil::RenderStats& stats);
+	void RecordSceneWorker(uint32_t frameIndex, uint32_t imageIndex, uint32_t worker, uint32_t firstDraw, uint32_t drawCount, vkUtil::RenderStats& stats);
+	void RecordDrawCommandsSky(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t imageIndex, Scene* scene);
+	void RecordViewportState(vk::CommandBuffer commandBuffer);
 
 	void DestroySwapChain();
 };
\ No newline at end of file
@@ -19,15 +19,27 @@ void vkUtil::SwapChainFrame::CreateDescriptorResources()
 
 	cameraMatrixWriteLocation = logicalDevice.mapMemory(cameraMatrixBuffer.m_bufferMemory, 0, sizeof(CameraMatrices));
 
-	input.m_size = 1024 * sizeof(glm::mat4);
-	input.m_usage = vk::BufferUsageFlagBits::eStorageBuffer;
-	modelBuffer = CreateBuffer(input);
-
-	modelBufferWriteLocation = logicalDevice.mapMemory(modelBuffer.m_bufferMemory, 0, 1024 * sizeof(glm::mat4));
+	vk::DeviceSize drawCommandSize = drawCommands.size() * sizeof(vk::DrawIndexedIndirectCommand);
+	input.m_size = drawCommandSize;
+	if (gpuCulling)
+	{
+		//Instance counts are produced on the GPU
+		input.m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		input.m_usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst;
+		drawCommandBuffer = CreateBuffer(input);
+		drawCommandWriteLocation = nullptr;
+	}
+	else
+	{
+		//Persistently mapped, the CPU writes the culled draws every frame
+		input.m_usage = vk::BufferUsageFlagBits::eIndirectBuffer;
+		drawCommandBuffer = CreateBuffer(input);
+		drawCommandWriteLocation = logicalDevice.mapMemory(drawCommandBuffer.m_bufferMemory, 0, drawCommandSize);
+	}
 
-	modelTransforms.reserve(1024);
-	for (int i = 0; i < 1024; ++i)
-		modelTransforms.push_back(glm::mat4(1.f));
+	drawCommandDescriptor.buffer = drawCommandBuffer.m_buffer;
+	drawCommandDescriptor.offset = 0;
+	drawCommandDescriptor.range = drawCommandSize;
 
 	cameraVectorDescriptor.buffer = cameraVectorBuffer.m_buffer;
 	cameraVectorDescriptor.offset = 0;
@@ -37,12 +49,131 @@ void vkUtil::SwapChainFrame::CreateDescriptorResources()
 	cameraMatrixDescriptor.offset = 0;
 	cameraMatrixDescriptor.range = sizeof(CameraMatrices);
 
+	//Starting size, grows with the scene through ReserveInstances
+	instanceCapacity = 1024;
+	CreateInstanceResources();
+}
+
+void vkUtil::SwapChainFrame::CreateInstanceResources()
+{
+	BufferInputChunk input;
+	input.m_logicalDevice = logicalDevice;
+	input.m_physicalDevice = physicalDevice;
+	input.m_memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	input.m_usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+	input.m_size = instanceCapacity * sizeof(InstanceData);
+	instanceBuffer = CreateBuffer(input);
+	instanceWriteLocation = logicalDevice.mapMemory(instanceBuffer.m_bufferMemory, 0, input.m_size);
+	instanceLayoutVersion = std::numeric_limits<uint64_t>::max();
+	transformCursor = 0;
+
+	input.m_size = instanceCapacity * sizeof(TransformUpload);
+	transformUploadBuffer = CreateBuffer(input);
+	transformUploadWriteLocation = logicalDevice.mapMemory(transformUploadBuffer.m_bufferMemory, 0, input.m_size);
+	transformUploadCount = 0;
+
+	input.m_size = instanceCapacity * sizeof(uint32_t);
+	meshIndexBuffer = CreateBuffer(input);
+	meshIndexWriteLocation = logicalDevice.mapMemory(meshIndexBuffer.m_bufferMemory, 0, input.m_size);
+
+	expandSlotBuffer = CreateBuffer(input);
+	expandSlotWriteLocation = logicalDevice.mapMemory(expandSlotBuffer.m_bufferMemory, 0, input.m_size);
+
+	if (gpuCulling)
+	{
+		//Visible indices are produced on the GPU
+		input.m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		visibleIndexBuffer = CreateBuffer(input);
+		visibleIndexWriteLocation = nullptr;
+	}
+	else
+	{
+		visibleIndexBuffer = CreateBuffer(input);
+		visibleIndexWriteLocation = logicalDevice.mapMemory(visibleIndexBuffer.m_bufferMemory, 0, input.m_size);
+	}
+
+	//Only ever written by the expansion pass
+	input.m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	input.m_size = instanceCapacity * sizeof(glm::mat4);
+	modelBuffer = CreateBuffer(input);
+	instanceExpandCount = 0;
+	instanceExpandAll = true;
+
+	instanceDescriptor.buffer = instanceBuffer.m_buffer;
+	instanceDescriptor.offset = 0;
+	instanceDescriptor.range = instanceCapacity * sizeof(InstanceData);
+
 	modelBufferDescriptor.buffer = modelBuffer.m_buffer;
 	modelBufferDescriptor.offset = 0;
-	modelBufferDescriptor.range = 1024 * sizeof(glm::mat4);
+	modelBufferDescriptor.range = instanceCapacity * sizeof(glm::mat4);
+
+	transformUploadDescriptor.buffer = transformUploadBuffer.m_buffer;
+	transformUploadDescriptor.offset = 0;
+	transformUploadDescriptor.range = instanceCapacity * sizeof(TransformUpload);
+
+	expandSlotDescriptor.buffer = expandSlotBuffer.m_buffer;
+	expandSlotDescriptor.offset = 0;
+	expandSlotDescriptor.range = instanceCapacity * sizeof(uint32_t);
+
+	meshIndexDescriptor.buffer = meshIndexBuffer.m_buffer;
+	meshIndexDescriptor.offset = 0;
+	meshIndexDescriptor.range = instanceCapacity * sizeof(uint32_t);
+
+	visibleIndexDescriptor.buffer = visibleIndexBuffer.m_buffer;
+	visibleIndexDescriptor.offset = 0;
+	visibleIndexDescriptor.range = instanceCapacity * sizeof(uint32_t);
+}
+
+void vkUtil::SwapChainFrame::DestroyInstanceResources()
+{
+	logicalDevice.unmapMemory(instanceBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, instanceBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(instanceBuffer.m_buffer);
+
+	vkUtil::FreeMemory(logicalDevice, modelBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(modelBuffer.m_buffer);
+
+	logicalDevice.unmapMemory(transformUploadBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, transformUploadBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(transformUploadBuffer.m_buffer);
+
+	logicalDevice.unmapMemory(meshIndexBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, meshIndexBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(meshIndexBuffer.m_buffer);
+
+	logicalDevice.unmapMemory(expandSlotBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, expandSlotBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(expandSlotBuffer.m_buffer);
+
+	if (visibleIndexWriteLocation)
+		logicalDevice.unmapMemory(visibleIndexBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, visibleIndexBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(visibleIndexBuffer.m_buffer);
+}
+
+bool vkUtil::SwapChainFrame::ReserveInstances(uint32_t instanceCount)
+{
+	if (instanceCount <= instanceCapacity)
+		return false;
+
+	//Grow geometrically so a steadily growing scene reallocates rarely
+	instanceCapacity = std::max(instanceCount, instanceCapacity * 2);
+
+	//Only this slot's last submission used the old buffers and sets, so only its fence is waited on, never the device.
+	//Render reserves right after waiting on it, so this normally returns at once.
+	static_cast<void>(logicalDevice.waitForFences(1, &inFlight, VK_TRUE, UINT64_MAX));
+
+	DestroyInstanceResources();
+	CreateInstanceResources();
+
+	RecordWriteOperations();
+	WriteDescriptorSet();
+
+	return true;
 }
 
-void vkUtil::SwapChainFrame::CreateDepthResources()
+void vkUtil::SwapChainImage::CreateDepthResources()
 {
 	depthFormat = vkImage::FindSupportedFormat(physicalDevice, { vk::Format::eD32Sfloat, vk::Format::eD24UnormS8Uint }, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment);
 
@@ -62,6 +193,24 @@ void vkUtil::SwapChainFrame::CreateDepthResources()
 	depthBufferView = vkImage::CreateImageView(logicalDevice, depthBuffer, depthFormat, vk::ImageAspectFlagBits::eDepth, vk::ImageViewType::e2D, 1);
 }
 
+void vkUtil::SwapChainImage::CreateOffscreenImage(vk::Format format)
+{
+	vkImage::ImageInputChunk imageInfo;
+	imageInfo.m_logicalDevice = logicalDevice;
+	imageInfo.m_physicalDevice = physicalDevice;
+	imageInfo.m_tiling = vk::ImageTiling::eOptimal;
+	imageInfo.m_usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+	imageInfo.m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	imageInfo.m_width = width;
+	imageInfo.m_height = height;
+	imageInfo.m_format = format;
+	imageInfo.m_arrayCount = 1;
+
+	image = vkImage::CreateImage(imageInfo);
+	imageMemory = vkImage::CreateImageMemory(imageInfo, image);
+	imageView = vkImage::CreateImageView(logicalDevice, image, format, vk::ImageAspectFlagBits::eColor, vk::ImageViewType::e2D, 1);
+}
+
 void vkUtil::SwapChainFrame::WriteDescriptorSet()
 {
 	logicalDevice.updateDescriptorSets(writeOps, nullptr);
@@ -95,31 +244,111 @@ void vkUtil::SwapChainFrame::RecordWriteOperations()
 	ssboWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
 	ssboWrite.pBufferInfo = &modelBufferDescriptor;
 
-	writeOps = { { cameraVectorWrite, cameraMatrixWrite, ssboWrite } };
+	vk::WriteDescriptorSet visibleIndexWrite;
+	visibleIndexWrite.dstSet = descriptorSet[PipelineTypes::STANDARD];
+	visibleIndexWrite.dstBinding = 2;
+	visibleIndexWrite.dstArrayElement = 0;
+	visibleIndexWrite.descriptorCount = 1;
+	visibleIndexWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+	visibleIndexWrite.pBufferInfo = &visibleIndexDescriptor;
+
+	vk::WriteDescriptorSet meshIndexWrite = visibleIndexWrite;
+	meshIndexWrite.dstBinding = 3;
+	meshIndexWrite.pBufferInfo = &meshIndexDescriptor;
+
+	writeOps = { { cameraVectorWrite, cameraMatrixWrite, ssboWrite, visibleIndexWrite, meshIndexWrite } };
+
+	//Transform scatter compute set, bindings match scatter.comp
+	vk::WriteDescriptorSet uploadWrite = visibleIndexWrite;
+	uploadWrite.dstSet = scatterDescriptorSet;
+	uploadWrite.dstBinding = 0;
+	uploadWrite.pBufferInfo = &transformUploadDescriptor;
+	writeOps.push_back(uploadWrite);
+
+	vk::WriteDescriptorSet scatterInstanceWrite = uploadWrite;
+	scatterInstanceWrite.dstBinding = 1;
+	scatterInstanceWrite.pBufferInfo = &instanceDescriptor;
+	writeOps.push_back(scatterInstanceWrite);
+
+	//Instance expansion compute set, bindings match expand.comp
+	vk::WriteDescriptorSet expandInstanceWrite = scatterInstanceWrite;
+	expandInstanceWrite.dstSet = expandDescriptorSet;
+	expandInstanceWrite.dstBinding = 0;
+	writeOps.push_back(expandInstanceWrite);
+
+	vk::WriteDescriptorSet expandModelWrite = expandInstanceWrite;
+	expandModelWrite.dstBinding = 1;
+	expandModelWrite.pBufferInfo = &modelBufferDescriptor;
+	writeOps.push_back(expandModelWrite);
+
+	vk::WriteDescriptorSet expandSlotWrite = expandInstanceWrite;
+	expandSlotWrite.dstBinding = 2;
+	expandSlotWrite.pBufferInfo = &expandSlotDescriptor;
+	writeOps.push_back(expandSlotWrite);
+
+	if (!gpuCulling)
+		return;
+
+	//Culling compute set, bindings match cull.comp
+	const vk::DescriptorBufferInfo* cullBuffers[] =
+	{
+		&modelBufferDescriptor, &meshIndexDescriptor, &meshBoundsDescriptor, &drawCommandDescriptor, &visibleIndexDescriptor
+	};
+
+	for (uint32_t binding = 0; binding < 5; ++binding)
+	{
+		vk::WriteDescriptorSet cullWrite;
+		cullWrite.dstSet = cullDescriptorSet;
+		cullWrite.dstBinding = binding;
+		cullWrite.dstArrayElement = 0;
+		cullWrite.descriptorCount = 1;
+		cullWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+		cullWrite.pBufferInfo = cullBuffers[binding];
+		writeOps.push_back(cullWrite);
+	}
 }
 
-void vkUtil::SwapChainFrame::Destroy()
+void vkUtil::SwapChainImage::Destroy()
 {
 	logicalDevice.destroyImageView(imageView);
 	logicalDevice.destroyFramebuffer(framebuffer[PipelineTypes::SKY]);
 	logicalDevice.destroyFramebuffer(framebuffer[PipelineTypes::STANDARD]);
+	logicalDevice.destroySemaphore(renderFinished);
+
+	if (imageMemory)
+	{
+		logicalDevice.destroyImage(image);
+		vkUtil::FreeMemory(logicalDevice, imageMemory);
+	}
+
+	logicalDevice.destroyImage(depthBuffer);
+	vkUtil::FreeMemory(logicalDevice, depthBufferMemory);
+	logicalDevice.destroyImageView(depthBufferView);
+}
+
+void vkUtil::SwapChainFrame::Destroy()
+{
 	logicalDevice.destroyFence(inFlight);
 	logicalDevice.destroySemaphore(imageAvailable);
-	logicalDevice.destroySemaphore(renderFinished);
+
+	//Frees the worker command buffers too
+	for (vk::CommandPool workerCommandPool : workerCommandPools)
+	{
+		logicalDevice.destroyCommandPool(workerCommandPool);
+	}
 
 	logicalDevice.unmapMemory(cameraVectorBuffer.m_bufferMemory);
-	logicalDevice.freeMemory(cameraVectorBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, cameraVectorBuffer.m_bufferMemory);
 	logicalDevice.destroyBuffer(cameraVectorBuffer.m_buffer);
 
 	logicalDevice.unmapMemory(cameraMatrixBuffer.m_bufferMemory);
-	logicalDevice.freeMemory(cameraMatrixBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, cameraMatrixBuffer.m_bufferMemory);
 	logicalDevice.destroyBuffer(cameraMatrixBuffer.m_buffer);
 
-	logicalDevice.unmapMemory(modelBuffer.m_bufferMemory);
-	logicalDevice.freeMemory(modelBuffer.m_bufferMemory);
-	logicalDevice.destroyBuffer(modelBuffer.m_buffer);
+	DestroyInstanceResources();
 
-	logicalDevice.destroyImage(depthBuffer);
-	logicalDevice.freeMemory(depthBufferMemory);
-	logicalDevice.destroyImageView(depthBufferView);
+	if (drawCommandWriteLocation)
+		logicalDevice.unmapMemory(drawCommandBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(logicalDevice, drawCommandBuffer.m_bufferMemory);
+	logicalDevice.destroyBuffer(drawCommandBuffer.m_buffer);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "Config.h"
+#include "RenderStructs.h"
 
 namespace vkUtil 
 {
@@ -18,17 +19,19 @@ namespace vkUtil
 	};
 
 	/**
-		Holds the data structures associated with a "Frame"
+		Holds the attachments of one swapchain image, everything
+		whose lifetime follows the swapchain rather than the frames in flight
 	*/
-	class SwapChainFrame 
+	class SwapChainImage
 	{
 	public:
 		vk::Device logicalDevice;
 		vk::PhysicalDevice physicalDevice;
 
-		// Swapchain
 		vk::Image image;
 		vk::ImageView imageView;
+		// Only set for offscreen images, swapchain images belong to the swapchain
+		vk::DeviceMemory imageMemory;
 		std::unordered_map<PipelineTypes, vk::Framebuffer> framebuffer;
 		vk::Image depthBuffer;
 		vk::DeviceMemory depthBufferMemory;
@@ -36,11 +39,43 @@ namespace vkUtil
 		vk::Format depthFormat;
 		int width, height;
 
+		// Signalled by the rendering into this image, waited on by its present
+		vk::Semaphore renderFinished;
+
+		void CreateDepthResources();
+
+		/**
+			Make an engine owned color image to render into instead of a swapchain image.
+			It can be copied from, so rendered frames can be read back.
+
+			\param format the color format to render in
+		*/
+		void CreateOffscreenImage(vk::Format format);
+
+		void Destroy();
+	};
+
+	/**
+		Holds the data structures associated with a "Frame": one slot of the
+		frames in flight ring, recorded and submitted while other slots are still on the GPU
+	*/
+	class SwapChainFrame 
+	{
+	public:
+		vk::Device logicalDevice;
+		vk::PhysicalDevice physicalDevice;
+
 		vk::CommandBuffer commandBuffer;
 
+		// Secondary command buffers recorded in parallel, each worker owns one pool.
+		// Made the first time scene recording splits, empty until then
+		std::vector<vk::CommandPool> workerCommandPools;
+		std::vector<vk::CommandBuffer> workerCommandBuffers;
+
 		// Synchronization
-		vk::Semaphore imageAvailable, renderFinished;
+		vk::Semaphore imageAvailable;
 		vk::Fence inFlight;
+		uint64_t submissionSerial{ 0 };
 
 		// Resources
 		CameraMatrices cameraMatrixData;
@@ -51,22 +86,88 @@ namespace vkUtil
 		Buffer cameraVectorBuffer;
 		void* cameraVectorWriteLocation;
 
-		std::vector<glm::mat4> modelTransforms;
+		// Compact transform of every instance, persistently mapped
+		Buffer instanceBuffer;
+		void* instanceWriteLocation;
+
+		// Scene state the instance buffer holds, only the changes since are uploaded
+		uint64_t instanceLayoutVersion;
+		uint64_t transformCursor;
+
+		// Large batches of changed transforms, scattered into instanceBuffer by a compute pass
+		Buffer transformUploadBuffer;
+		void* transformUploadWriteLocation;
+		uint32_t transformUploadCount;
+
+		// Model matrix of every instance, expanded from instanceBuffer by a compute pass
+		// whenever instances changed, device local
 		Buffer modelBuffer;
-		void* modelBufferWriteLocation;
+		uint32_t instanceExpandCount;
+		// Whether every instance is expanded, otherwise only the slots in expandSlotBuffer
+		bool instanceExpandAll;
+
+		// Slots of the changed instances, the only model matrices expanded again
+		Buffer expandSlotBuffer;
+		void* expandSlotWriteLocation;
+
+		// Number of instances the per instance buffers below can hold
+		uint32_t instanceCapacity;
+
+		// Mesh of each instance, lets shaders find per draw data
+		Buffer meshIndexBuffer;
+		void* meshIndexWriteLocation;
+
+		// Indices into modelBuffer of the instances surviving culling, packed per draw,
+		// and one indirect draw per mesh type.
+		// Written by the CPU (mapped) or by the culling compute pass (device local).
+		Buffer visibleIndexBuffer;
+		void* visibleIndexWriteLocation;
+		Buffer drawCommandBuffer;
+		void* drawCommandWriteLocation;
+		std::vector<vk::DrawIndexedIndirectCommand> drawCommands;
+
+		// GPU culling
+		bool gpuCulling;
+		CullParameters cullParameters;
 
 		// Resource descriptors
 		vk::DescriptorBufferInfo cameraVectorDescriptor;
 		vk::DescriptorBufferInfo cameraMatrixDescriptor;
+		vk::DescriptorBufferInfo instanceDescriptor;
 		vk::DescriptorBufferInfo modelBufferDescriptor;
+		vk::DescriptorBufferInfo visibleIndexDescriptor;
+		vk::DescriptorBufferInfo meshIndexDescriptor;
+		vk::DescriptorBufferInfo meshBoundsDescriptor;
+		vk::DescriptorBufferInfo drawCommandDescriptor;
+		vk::DescriptorBufferInfo transformUploadDescriptor;
+		vk::DescriptorBufferInfo expandSlotDescriptor;
 		std::unordered_map<PipelineTypes, vk::DescriptorSet> descriptorSet;
+		vk::DescriptorSet cullDescriptorSet;
+		vk::DescriptorSet scatterDescriptorSet;
+		vk::DescriptorSet expandDescriptorSet;
 
 		//Write Ops
 		std::vector<vk::WriteDescriptorSet> writeOps;
 
 		void CreateDescriptorResources();
 
-		void CreateDepthResources();
+		/**
+			Make the per instance buffers (transforms, model matrices, meshes, visible indices, transform uploads, expand slots)
+			at the current capacity. Their contents are undefined, so the next upload rewrites everything.
+		*/
+		void CreateInstanceResources();
+
+		void DestroyInstanceResources();
+
+		/**
+			Make sure the per instance buffers can hold the given number of instances,
+			reallocating them and rewriting the descriptor sets if they can't.
+			Must be called before inFlight is reset for the next submission, growing waits on it.
+
+			\param instanceCount the number of instances about to be written
+			\returns whether the buffers were reallocated
+		*/
+		bool ReserveInstances(uint32_t instanceCount);
 
 		void WriteDescriptorSet();
 
@@ -0,0 +1,75 @@
+#include "FramePacer.h"
+
+namespace
+{
+	//Sleeps shorter than this are left to spinning, OS timers are too coarse for them
+	constexpr std::chrono::microseconds spinThreshold{ 2000 };
+
+	//Weight of the newest frame in the smoothed latency
+	constexpr double latencySmoothing = 0.1;
+}
+
+void vkUtil::FramePacer::SetTargetFrameRate(double framesPerSecond)
+{
+	if (framesPerSecond <= 0.0)
+	{
+		m_framePeriod = Clock::duration::zero();
+		return;
+	}
+
+	m_framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+	m_nextFrame = Clock::now();
+}
+
+double vkUtil::FramePacer::GetTargetFrameRate() const
+{
+	if (m_framePeriod == Clock::duration::zero())
+		return 0.0;
+
+	return 1.0 / std::chrono::duration<double>(m_framePeriod).count();
+}
+
+void vkUtil::FramePacer::WaitForNextFrame()
+{
+	if (m_framePeriod == Clock::duration::zero())
+		return;
+
+	Clock::time_point now = Clock::now();
+	if (m_nextFrame - now > spinThreshold)
+	{
+		std::this_thread::sleep_for(m_nextFrame - now - spinThreshold);
+	}
+
+	while (Clock::now() < m_nextFrame)
+	{
+		std::this_thread::yield();
+	}
+
+	//A late frame pushes the schedule back instead of bursting to catch up
+	m_nextFrame = std::max(m_nextFrame + m_framePeriod, Clock::now());
+}
+
+void vkUtil::FramePacer::MarkInputSampled()
+{
+	m_inputSampled = Clock::now();
+}
+
+void vkUtil::FramePacer::MarkPresented()
+{
+	m_latency = std::chrono::duration<double, std::milli>(Clock::now() - m_inputSampled).count();
+
+	if (m_averageLatency == 0.0)
+		m_averageLatency = m_latency;
+	else
+		m_averageLatency += latencySmoothing * (m_latency - m_averageLatency);
+}
+
+double vkUtil::FramePacer::GetLatency() const
+{
+	return m_latency;
+}
+
+double vkUtil::FramePacer::GetAverageLatency() const
+{
+	return m_averageLatency;
+}
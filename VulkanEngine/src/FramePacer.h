@@ -0,0 +1,57 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	/**
+		Paces the render loop: caps the frame rate with a precise sleep
+		and measures the latency from sampling input to presenting the frame built from it.
+	*/
+	class FramePacer
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/**
+			\param framesPerSecond the frame rate to hold, 0 for uncapped
+		*/
+		void SetTargetFrameRate(double framesPerSecond);
+
+		double GetTargetFrameRate() const;
+
+		/**
+			Block until the next frame is due under the frame rate cap. Sleeps coarsely
+			and spins out the last stretch, since OS sleeps overshoot by up to a scheduler tick.
+		*/
+		void WaitForNextFrame();
+
+		/**
+			Record that the input the coming frame is built from was just sampled.
+		*/
+		void MarkInputSampled();
+
+		/**
+			Record that the frame was handed to the presentation engine.
+			Queueing inside the presentation engine itself isn't visible to the application.
+		*/
+		void MarkPresented();
+
+		/**
+			\returns the input to present latency of the latest frame, in milliseconds
+		*/
+		double GetLatency() const;
+
+		/**
+			\returns the input to present latency smoothed over recent frames, in milliseconds
+		*/
+		double GetAverageLatency() const;
+
+	private:
+		Clock::duration m_framePeriod{ Clock::duration::zero() };
+		Clock::time_point m_nextFrame{ Clock::now() };
+
+		Clock::time_point m_inputSampled{ Clock::now() };
+		double m_latency{ 0.0 };
+		double m_averageLatency{ 0.0 };
+	};
+}
@@ -0,0 +1,179 @@
+#include "FrameStats.h"
+
+namespace
+{
+	double Milliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	/**
+		Nearest rank percentiles, sorts the samples in place.
+	*/
+	vkUtil::TimingPercentiles ComputePercentiles(std::vector<double>& samples)
+	{
+		vkUtil::TimingPercentiles percentiles;
+		if (samples.empty())
+			return percentiles;
+
+		std::sort(samples.begin(), samples.end());
+
+		auto rank = [&samples](double fraction)
+		{
+			size_t index = static_cast<size_t>(std::ceil(fraction * samples.size()));
+			return samples[std::clamp<size_t>(index, 1, samples.size()) - 1];
+		};
+
+		percentiles.m_p50 = rank(0.50);
+		percentiles.m_p95 = rank(0.95);
+		percentiles.m_p99 = rank(0.99);
+		percentiles.m_max = samples.back();
+		return percentiles;
+	}
+
+	void WritePercentilesJson(std::ostream& stream, const vkUtil::TimingPercentiles& percentiles)
+	{
+		stream << "{\"p50\":" << percentiles.m_p50 << ",\"p95\":" << percentiles.m_p95
+			<< ",\"p99\":" << percentiles.m_p99 << ",\"max\":" << percentiles.m_max << "}";
+	}
+}
+
+vkUtil::FrameStats::FrameStats(uint32_t capacity)
+	: m_frames(std::max(capacity, 1u))
+{
+}
+
+void vkUtil::FrameStats::SetHitchFactor(double hitchFactor)
+{
+	m_hitchFactor = hitchFactor;
+}
+
+void vkUtil::FrameStats::BeginFrame()
+{
+	m_frameActive = true;
+	m_frameStart = Clock::now();
+	m_fenceWait = Clock::duration::zero();
+}
+
+void vkUtil::FrameStats::AddFenceWait(Clock::duration wait)
+{
+	m_fenceWait += wait;
+}
+
+void vkUtil::FrameStats::MarkPresented()
+{
+	Clock::time_point now = Clock::now();
+
+	if (m_frameActive)
+	{
+		FrameTimings& timings = m_frames[m_next];
+		timings.m_frameMs = Milliseconds(now - m_frameStart);
+		timings.m_fenceWaitMs = Milliseconds(m_fenceWait);
+		//The first frame has no predecessor, its own frame time stands in
+		timings.m_presentIntervalMs = m_lastPresent ? Milliseconds(now - *m_lastPresent) : timings.m_frameMs;
+
+		m_next = (m_next + 1) % static_cast<uint32_t>(m_frames.size());
+		m_count = std::min(m_count + 1, static_cast<uint32_t>(m_frames.size()));
+	}
+
+	m_frameActive = false;
+	m_lastPresent = now;
+}
+
+uint32_t vkUtil::FrameStats::GetFrameCount() const
+{
+	return m_count;
+}
+
+vkUtil::FrameStatsSummary vkUtil::FrameStats::Summarize(uint32_t windowFrames) const
+{
+	FrameStatsSummary summary;
+	summary.m_frameCount = (windowFrames == 0) ? m_count : std::min(windowFrames, m_count);
+
+	std::vector<double> frame, fenceWait, presentInterval;
+	frame.reserve(summary.m_frameCount);
+	fenceWait.reserve(summary.m_frameCount);
+	presentInterval.reserve(summary.m_frameCount);
+
+	for (uint32_t age = 0; age < summary.m_frameCount; ++age)
+	{
+		const FrameTimings& timings = GetFrame(age);
+		frame.push_back(timings.m_frameMs);
+		fenceWait.push_back(timings.m_fenceWaitMs);
+		presentInterval.push_back(timings.m_presentIntervalMs);
+	}
+
+	summary.m_frame = ComputePercentiles(frame);
+	summary.m_fenceWait = ComputePercentiles(fenceWait);
+	summary.m_presentInterval = ComputePercentiles(presentInterval);
+
+	//Relative to the median, so a steady 30 fps isn't one long hitch
+	double hitchThreshold = m_hitchFactor * summary.m_presentInterval.m_p50;
+	for (double interval : presentInterval)
+	{
+		if (interval > hitchThreshold)
+			++summary.m_hitchCount;
+	}
+
+	return summary;
+}
+
+bool vkUtil::FrameStats::WriteCsv(const char* filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write \"" << filename << "\"" << std::endl;
+		return false;
+	}
+
+	file << "frame,frame_ms,fence_wait_ms,present_interval_ms\n";
+	for (uint32_t i = 0; i < m_count; ++i)
+	{
+		const FrameTimings& timings = GetFrame(m_count - 1 - i);
+		file << i << "," << timings.m_frameMs << "," << timings.m_fenceWaitMs << "," << timings.m_presentIntervalMs << "\n";
+	}
+
+	return true;
+}
+
+bool vkUtil::FrameStats::WriteJson(const char* filename) const
+{
+	std::ofstream file(filename);
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write \"" << filename << "\"" << std::endl;
+		return false;
+	}
+
+	file << "{\n\"summary\":";
+	WriteSummaryJson(file, Summarize());
+	file << ",\n\"columns\":[\"frame_ms\",\"fence_wait_ms\",\"present_interval_ms\"]";
+	file << ",\n\"frames\":[";
+
+	for (uint32_t i = 0; i < m_count; ++i)
+	{
+		const FrameTimings& timings = GetFrame(m_count - 1 - i);
+		file << (i == 0 ? "\n" : ",\n") << "[" << timings.m_frameMs << "," << timings.m_fenceWaitMs << "," << timings.m_presentIntervalMs << "]";
+	}
+
+	file << "\n]\n}\n";
+	return true;
+}
+
+const vkUtil::FrameTimings& vkUtil::FrameStats::GetFrame(uint32_t age) const
+{
+	uint32_t capacity = static_cast<uint32_t>(m_frames.size());
+	return m_frames[(m_next + capacity - 1 - age) % capacity];
+}
+
+void vkUtil::WriteSummaryJson(std::ostream& stream, const FrameStatsSummary& summary)
+{
+	stream << "{\"frames\":" << summary.m_frameCount << ",\"frame_ms\":";
+	WritePercentilesJson(stream, summary.m_frame);
+	stream << ",\"fence_wait_ms\":";
+	WritePercentilesJson(stream, summary.m_fenceWait);
+	stream << ",\"present_interval_ms\":";
+	WritePercentilesJson(stream, summary.m_presentInterval);
+	stream << ",\"hitches\":" << summary.m_hitchCount << "}";
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	/**
+		Timings of one frame, in milliseconds.
+	*/
+	struct FrameTimings
+	{
+		// CPU time from the end of pacing until the frame was handed to present
+		double m_frameMs;
+		// Part of the frame spent blocked on in flight fences
+		double m_fenceWaitMs;
+		// Time since the previous frame was presented, the frame period as seen on screen
+		double m_presentIntervalMs;
+	};
+
+	struct TimingPercentiles
+	{
+		double m_p50{ 0.0 };
+		double m_p95{ 0.0 };
+		double m_p99{ 0.0 };
+		double m_max{ 0.0 };
+	};
+
+	struct FrameStatsSummary
+	{
+		uint32_t m_frameCount{ 0 };
+		TimingPercentiles m_frame;
+		TimingPercentiles m_fenceWait;
+		TimingPercentiles m_presentInterval;
+		// Frames whose present interval exceeded the hitch factor times the window's median
+		uint32_t m_hitchCount{ 0 };
+	};
+
+	/**
+		Keeps the timings of recent frames in a fixed size ring,
+		so percentiles and hitches can be computed instead of only an average.
+	*/
+	class FrameStats
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/**
+			\param capacity the number of most recent frames kept
+		*/
+		FrameStats(uint32_t capacity = 4096);
+
+		/**
+			\param hitchFactor how many times the median present interval a frame has to take to count as a hitch
+		*/
+		void SetHitchFactor(double hitchFactor);
+
+		/**
+			Start timing a frame. A frame that is never presented is dropped by the next call.
+		*/
+		void BeginFrame();
+
+		/**
+			Add time the current frame spent blocked on the GPU.
+		*/
+		void AddFenceWait(Clock::duration wait);
+
+		/**
+			Finish the current frame once it was handed to the presentation engine.
+		*/
+		void MarkPresented();
+
+		/**
+			\returns the number of frames held in the ring
+		*/
+		uint32_t GetFrameCount() const;
+
+		/**
+			\param windowFrames the number of most recent frames to cover, 0 for every frame held
+			\returns percentiles and the hitch count over the window
+		*/
+		FrameStatsSummary Summarize(uint32_t windowFrames = 0) const;
+
+		/**
+			Write every frame held, oldest first, one row per frame.
+
+			\returns whether the file could be written
+		*/
+		bool WriteCsv(const char* filename) const;
+
+		/**
+			Write the summary over every frame held, followed by the frames themselves.
+
+			\returns whether the file could be written
+		*/
+		bool WriteJson(const char* filename) const;
+
+	private:
+		std::vector<FrameTimings> m_frames;
+		// Slot the next frame goes into, and how many slots hold a frame
+		uint32_t m_next{ 0 };
+		uint32_t m_count{ 0 };
+
+		double m_hitchFactor{ 2.0 };
+
+		bool m_frameActive{ false };
+		Clock::time_point m_frameStart;
+		Clock::duration m_fenceWait{ Clock::duration::zero() };
+		std::optional<Clock::time_point> m_lastPresent;
+
+		/**
+			\param age 0 for the newest frame held
+		*/
+		const FrameTimings& GetFrame(uint32_t age) const;
+	};
+
+	/**
+		Write the percentiles of a summary as a JSON object, without a trailing newline.
+	*/
+	void WriteSummaryJson(std::ostream& stream, const FrameStatsSummary& summary);
+}
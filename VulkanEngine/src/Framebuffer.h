@@ -18,10 +18,10 @@ namespace vkInit
 	/**
 		Make framebuffers for the swapchain
 		\param inputChunk required input for creation
-		\param frames the vector to be populated with the created framebuffers
+		\param frames the swapchain images to be populated with the created framebuffers
 		\param debug whether the system is running in debug mode.
 	*/
-	void CreateFramebuffers(FramebufferInput inputChunk, std::vector<vkUtil::SwapChainFrame>& frames, bool debug) 
+	void CreateFramebuffers(FramebufferInput inputChunk, std::vector<vkUtil::SwapChainImage>& frames, bool debug) 
 	{
 		for (int i = 0; i < frames.size(); ++i) 
 		{
@@ -0,0 +1,203 @@
+#include "GpuProfiler.h"
+
+vkUtil::GpuProfiler::GpuProfiler(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxZones)
+	: m_device{ device },
+	m_maxZones{ maxZones }
+{
+	vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+
+	//Timestamps need support on every graphics and compute queue, and valid bits on the one recorded to
+	m_supported = properties.limits.timestampComputeAndGraphics;
+	m_timestampPeriod = properties.limits.timestampPeriod;
+	if (!m_supported)
+		return;
+
+	uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+	if (validBits == 0)
+	{
+		m_supported = false;
+		return;
+	}
+	m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	vk::QueryPoolCreateInfo poolInfo;
+	poolInfo.flags = vk::QueryPoolCreateFlags();
+	poolInfo.queryType = vk::QueryType::eTimestamp;
+	poolInfo.queryCount = 2 * maxZones;
+
+	m_frames.resize(frameCount);
+	for (FrameQueries& frame : m_frames)
+	{
+		try
+		{
+			frame.m_queryPool = m_device.createQueryPool(poolInfo);
+		}
+		catch (vk::SystemError err)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool");
+		}
+	}
+}
+
+vkUtil::GpuProfiler::~GpuProfiler()
+{
+	for (FrameQueries& frame : m_frames)
+	{
+		m_device.destroyQueryPool(frame.m_queryPool);
+	}
+}
+
+void vkUtil::GpuProfiler::BeginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!m_supported)
+		return;
+
+	ReadBack(frameIndex);
+
+	FrameQueries& frame = m_frames[frameIndex];
+	frame.m_names.clear();
+	commandBuffer.resetQueryPool(frame.m_queryPool, 0, 2 * m_maxZones);
+
+	if (m_reportInterval > Clock::duration::zero() && Clock::now() - m_lastReport >= m_reportInterval)
+	{
+		Report();
+		m_lastReport = Clock::now();
+	}
+}
+
+uint32_t vkUtil::GpuProfiler::BeginZone(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const char* name)
+{
+	if (!m_supported)
+		return UINT32_MAX;
+
+	FrameQueries& frame = m_frames[frameIndex];
+	if (frame.m_names.size() >= m_maxZones)
+		return UINT32_MAX;
+
+	uint32_t zone = static_cast<uint32_t>(frame.m_names.size());
+	frame.m_names.push_back(name);
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.m_queryPool, 2 * zone);
+	return zone;
+}
+
+void vkUtil::GpuProfiler::EndZone(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t zone)
+{
+	if (zone == UINT32_MAX)
+		return;
+
+	commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_frames[frameIndex].m_queryPool, 2 * zone + 1);
+}
+
+void vkUtil::GpuProfiler::ReadBack(uint32_t frameIndex)
+{
+	FrameQueries& frame = m_frames[frameIndex];
+	if (frame.m_names.empty())
+		return;
+
+	//The frame's fence has signalled, so every query it wrote is available
+	uint32_t queryCount = 2 * static_cast<uint32_t>(frame.m_names.size());
+	std::vector<uint64_t> timestamps(queryCount);
+	vk::Result result = m_device.getQueryPoolResults(frame.m_queryPool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess)
+		return;
+
+	for (size_t zone = 0; zone < frame.m_names.size(); ++zone)
+	{
+		//Masking the difference too keeps it right when the counter wrapped in between
+		uint64_t begin = timestamps[2 * zone] & m_timestampMask;
+		uint64_t end = timestamps[2 * zone + 1] & m_timestampMask;
+		uint64_t ticks = (end - begin) & m_timestampMask;
+		AddSample(frame.m_names[zone], ticks * m_timestampPeriod / 1000000.0);
+	}
+}
+
+void vkUtil::GpuProfiler::AddSample(const char* name, double milliseconds)
+{
+	auto index = m_zoneIndices.find(name);
+	if (index == m_zoneIndices.end())
+	{
+		index = m_zoneIndices.emplace(name, m_zones.size()).first;
+		ZoneHistory zone;
+		zone.m_name = name;
+		zone.m_samples.reserve(historySize);
+		m_zones.push_back(std::move(zone));
+	}
+
+	ZoneHistory& zone = m_zones[index->second];
+	zone.m_last = milliseconds;
+	if (zone.m_samples.size() < historySize)
+	{
+		zone.m_samples.push_back(milliseconds);
+	}
+	else
+	{
+		zone.m_samples[zone.m_next] = milliseconds;
+	}
+	zone.m_next = (zone.m_next + 1) % historySize;
+}
+
+std::vector<vkUtil::GpuZoneStats> vkUtil::GpuProfiler::GetStats() const
+{
+	std::vector<GpuZoneStats> stats;
+	stats.reserve(m_zones.size());
+
+	for (const ZoneHistory& zone : m_zones)
+	{
+		GpuZoneStats zoneStats;
+		zoneStats.m_name = zone.m_name;
+		zoneStats.m_lastMs = zone.m_last;
+		zoneStats.m_minMs = *std::min_element(zone.m_samples.begin(), zone.m_samples.end());
+		zoneStats.m_maxMs = *std::max_element(zone.m_samples.begin(), zone.m_samples.end());
+
+		double total = 0.0;
+		for (double sample : zone.m_samples)
+		{
+			total += sample;
+		}
+		zoneStats.m_averageMs = total / zone.m_samples.size();
+
+		stats.push_back(zoneStats);
+	}
+
+	return stats;
+}
+
+void vkUtil::GpuProfiler::SetReportInterval(double seconds)
+{
+	m_reportInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(seconds, 0.0)));
+}
+
+bool vkUtil::GpuProfiler::IsSupported() const
+{
+	return m_supported;
+}
+
+void vkUtil::GpuProfiler::Report() const
+{
+	//Formatted locally, so std::cout keeps its own flags
+	std::ostringstream report;
+	report << "GPU time (ms)       last     min     avg     max\n";
+	for (const GpuZoneStats& zone : GetStats())
+	{
+		report << "  " << std::left << std::setw(16) << zone.m_name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(8) << zone.m_lastMs
+			<< std::setw(8) << zone.m_minMs
+			<< std::setw(8) << zone.m_averageMs
+			<< std::setw(8) << zone.m_maxMs << '\n';
+	}
+	std::cout << report.str() << std::flush;
+}
+
+vkUtil::GpuZone::GpuZone(GpuProfiler& profiler, vk::CommandBuffer commandBuffer, uint32_t frameIndex, const char* name)
+	: m_profiler{ profiler },
+	m_commandBuffer{ commandBuffer },
+	m_frameIndex{ frameIndex },
+	m_zone{ profiler.BeginZone(commandBuffer, frameIndex, name) }
+{
+}
+
+vkUtil::GpuZone::~GpuZone()
+{
+	m_profiler.EndZone(m_commandBuffer, m_frameIndex, m_zone);
+}
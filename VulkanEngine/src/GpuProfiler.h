@@ -0,0 +1,130 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	/**
+		GPU time of one profiled zone, over the recent frames.
+	*/
+	struct GpuZoneStats
+	{
+		std::string m_name;
+		double m_lastMs;
+		double m_minMs;
+		double m_averageMs;
+		double m_maxMs;
+	};
+
+	/**
+		Measures GPU time per pass with timestamp queries. Every frame in flight owns a
+		query pool, which is read back once that frame's fence has been waited on, so
+		results arrive a few frames late but reading them never stalls.
+	*/
+	class GpuProfiler
+	{
+	public:
+		/**
+			\param device the logical device
+			\param physicalDevice the physical device, to check timestamp support
+			\param queueFamilyIndex the queue family the zones are recorded on
+			\param frameCount the number of frames in flight
+			\param maxZones the most zones one frame may record
+		*/
+		GpuProfiler(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxZones);
+		~GpuProfiler();
+
+		/**
+			Collect the results of the frame's previous submission and reset its queries.
+			Must be recorded outside of a renderpass, after the frame's fence was waited on.
+
+			\param commandBuffer the frame's command buffer, being recorded
+			\param frameIndex the frame in flight
+		*/
+		void BeginFrame(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+
+		/**
+			Write the timestamp opening a zone.
+
+			\param name the zone's name, must outlive the profiler (a literal)
+			\returns the zone, to close with EndZone
+		*/
+		uint32_t BeginZone(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const char* name);
+
+		/**
+			Write the timestamp closing a zone.
+		*/
+		void EndZone(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t zone);
+
+		/**
+			\returns the rolling statistics of every zone seen so far, in the order first seen
+		*/
+		std::vector<GpuZoneStats> GetStats() const;
+
+		/**
+			\param seconds how often to print the statistics, 0 to never print them
+		*/
+		void SetReportInterval(double seconds);
+
+		/**
+			\returns whether the device supports timestamps, otherwise zones are ignored
+		*/
+		bool IsSupported() const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		//Samples kept per zone for the rolling statistics
+		static constexpr uint32_t historySize = 120;
+
+		struct ZoneHistory
+		{
+			std::string m_name;
+			std::vector<double> m_samples;
+			uint32_t m_next{ 0 };
+			double m_last{ 0.0 };
+		};
+
+		struct FrameQueries
+		{
+			vk::QueryPool m_queryPool;
+			std::vector<const char*> m_names;
+		};
+
+		vk::Device m_device;
+		bool m_supported{ false };
+		double m_timestampPeriod{ 1.0 };
+		//Timestamps only have the queue family's valid bits, the rest is undefined
+		uint64_t m_timestampMask{ ~0ull };
+		uint32_t m_maxZones;
+		std::vector<FrameQueries> m_frames;
+
+		std::vector<ZoneHistory> m_zones;
+		std::unordered_map<std::string, size_t> m_zoneIndices;
+
+		Clock::duration m_reportInterval{ Clock::duration::zero() };
+		Clock::time_point m_lastReport{ Clock::now() };
+
+		void ReadBack(uint32_t frameIndex);
+		void AddSample(const char* name, double milliseconds);
+		void Report() const;
+	};
+
+	/**
+		Times the commands recorded during its lifetime as one zone.
+	*/
+	class GpuZone
+	{
+	public:
+		GpuZone(GpuProfiler& profiler, vk::CommandBuffer commandBuffer, uint32_t frameIndex, const char* name);
+		~GpuZone();
+
+		GpuZone(const GpuZone&) = delete;
+		GpuZone& operator=(const GpuZone&) = delete;
+
+	private:
+		GpuProfiler& m_profiler;
+		vk::CommandBuffer m_commandBuffer;
+		uint32_t m_frameIndex;
+		uint32_t m_zone;
+	};
+}
@@ -61,7 +61,7 @@ vk::DeviceMemory vkImage::CreateImageMemory(ImageInputChunk input, vk::Image ima
 
 	try
 	{
-		vk::DeviceMemory imageMemory = input.m_logicalDevice.allocateMemory(allocation);
+		vk::DeviceMemory imageMemory = vkUtil::AllocateMemory(input.m_logicalDevice, allocation);
 		input.m_logicalDevice.bindImageMemory(image, imageMemory, 0);
 		return imageMemory;
 	}
@@ -13,6 +13,8 @@ namespace vkImage
 		vk::Queue m_queue;
 		vk::DescriptorSetLayout m_layout;
 		vk::DescriptorPool m_descriptorPool;
+		//Held around the upload and descriptor allocation when textures load on several threads at once
+		std::mutex* m_uploadMutex{ nullptr };
 	};
 
 	struct ImageInputChunk
@@ -103,9 +103,10 @@ namespace vkInit
 	Create a Vulkan instance.
 	\param debug whether the system is being run in debug mode.
 	\param applicationName the name of the application.
+	\param headless whether to skip the window system extensions, nothing will be presented.
 	\returns the instance created.
 	*/
-	vk::Instance CreateInstance(bool debug, const char* appName)
+	vk::Instance CreateInstance(bool debug, const char* appName, bool headless)
 	{
 		if (debug)
 		{
@@ -171,11 +172,15 @@ namespace vkInit
 		* Everything with Vulkan is "opt-in", so we need to query which extensions glfw needs
 		* in order to interface with vulkan.
 		*/
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char*> extensions;
+		if (!headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		std::vector<const char*> layers;
 
@@ -0,0 +1,337 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+
+namespace
+{
+	// Set on worker threads, every other thread shares queue 0
+	thread_local const vkUtil::JobSystem* t_jobSystem = nullptr;
+	thread_local uint32_t t_queueIndex = 0;
+}
+
+vkUtil::JobSystem::JobSystem(uint32_t threadCount)
+{
+	//Threads waiting on jobs help run them, so one thread fewer is started
+	uint32_t workerCount = std::max(threadCount, 1u) - 1;
+
+	for (uint32_t i = 0; i <= workerCount; ++i)
+	{
+		m_queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	for (uint32_t i = 1; i <= workerCount; ++i)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+vkUtil::JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t vkUtil::JobSystem::GetThreadCount() const
+{
+	return static_cast<uint32_t>(m_workers.size()) + 1;
+}
+
+vkUtil::JobHandle vkUtil::JobSystem::Schedule(std::function<void()> work, const std::vector<JobHandle>& dependencies)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->m_work = std::move(work);
+
+	for (const JobHandle& dependency : dependencies)
+	{
+		if (!dependency)
+			continue;
+
+		std::lock_guard<std::mutex> lock(dependency->m_mutex);
+		if (!dependency->m_done)
+		{
+			++job->m_pendingDependencies;
+			dependency->m_dependents.push_back(job);
+		}
+		else if (dependency->m_exception && !job->m_exception)
+		{
+			job->m_exception = dependency->m_exception;
+		}
+	}
+
+	//Dependencies may all have finished while being wired up
+	if (--job->m_pendingDependencies == 0)
+		Push(job);
+
+	return job;
+}
+
+vkUtil::JobHandle vkUtil::JobSystem::ScheduleBackground(std::function<void()> work)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->m_work = std::move(work);
+	job->m_background = true;
+	job->m_pendingDependencies = 0;
+	Push(job);
+
+	return job;
+}
+
+void vkUtil::JobSystem::Wait(const JobHandle& job)
+{
+	if (!job)
+		return;
+
+	//Background jobs would hold the waiter up for far longer than the job it waits for,
+	//unless there's nobody else to run them
+	bool background = m_workers.empty();
+
+	uint32_t queueIndex = GetQueueIndex();
+	while (!job->m_done)
+	{
+		if (JobHandle other = Take(queueIndex, background))
+		{
+			Execute(other);
+			continue;
+		}
+
+		//Nothing to help with, the job is running elsewhere
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		++m_sleepers;
+		++m_sleepingWaiters;
+		m_wake.wait(lock, [this, &job, background]()
+			{
+				return job->m_done || m_queuedJobs > 0 || (background && m_queuedBackgroundJobs > 0);
+			});
+		--m_sleepingWaiters;
+		--m_sleepers;
+	}
+
+	if (job->m_exception)
+		std::rethrow_exception(job->m_exception);
+}
+
+void vkUtil::JobSystem::Wait(const std::vector<JobHandle>& jobs)
+{
+	std::exception_ptr exception;
+	for (const JobHandle& job : jobs)
+	{
+		try
+		{
+			Wait(job);
+		}
+		catch (...)
+		{
+			if (!exception)
+				exception = std::current_exception();
+		}
+	}
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+bool vkUtil::JobSystem::IsDone(const JobHandle& job) const
+{
+	return !job || job->m_done;
+}
+
+void vkUtil::JobSystem::ParallelFor(uint32_t jobCount, const std::function<void(uint32_t)>& job)
+{
+	if (jobCount == 0)
+		return;
+
+	//Not worth scheduling a single job
+	if (jobCount == 1 || m_workers.empty())
+	{
+		for (uint32_t i = 0; i < jobCount; ++i)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	std::vector<JobHandle> jobs;
+	jobs.reserve(jobCount - 1);
+	for (uint32_t i = 1; i < jobCount; ++i)
+	{
+		jobs.push_back(Schedule([&job, i]() { job(i); }));
+	}
+
+	//The caller runs the first job itself, then helps with the rest.
+	//Every job has to finish before anything is rethrown, they all refer to job.
+	std::exception_ptr exception;
+	try
+	{
+		job(0);
+	}
+	catch (...)
+	{
+		exception = std::current_exception();
+	}
+
+	Wait(jobs);
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+void vkUtil::JobSystem::WorkerLoop(uint32_t queueIndex)
+{
+	t_jobSystem = this;
+	t_queueIndex = queueIndex;
+	CpuProfiler::Get().SetThreadName("Worker");
+
+	while (true)
+	{
+		if (JobHandle job = Take(queueIndex, true))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		++m_sleepers;
+		m_wake.wait(lock, [this]() { return m_stopping || m_queuedJobs > 0 || m_queuedBackgroundJobs > 0; });
+		--m_sleepers;
+
+		if (m_stopping)
+			return;
+	}
+}
+
+uint32_t vkUtil::JobSystem::GetQueueIndex() const
+{
+	return t_jobSystem == this ? t_queueIndex : 0;
+}
+
+void vkUtil::JobSystem::Push(JobHandle job)
+{
+	if (job->m_background)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_backgroundQueue.m_mutex);
+			m_backgroundQueue.m_jobs.push_back(std::move(job));
+		}
+		++m_queuedBackgroundJobs;
+
+		//Waiting threads can't take it, so waking only one sleeper might miss every worker
+		if (m_sleepers > 0)
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_wake.notify_all();
+		}
+		return;
+	}
+
+	WorkQueue& queue = *m_queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		queue.m_jobs.push_back(std::move(job));
+	}
+	++m_queuedJobs;
+
+	//Sleepers count themselves before checking for jobs, so either they see this one or get woken
+	if (m_sleepers > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_one();
+	}
+}
+
+vkUtil::JobHandle vkUtil::JobSystem::Take(uint32_t queueIndex, bool background)
+{
+	//Newest first from the own queue, its data is most likely still in cache
+	{
+		WorkQueue& queue = *m_queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.m_mutex);
+		if (!queue.m_jobs.empty())
+		{
+			JobHandle job = std::move(queue.m_jobs.back());
+			queue.m_jobs.pop_back();
+			--m_queuedJobs;
+			return job;
+		}
+	}
+
+	//Oldest first from everyone else, those tend to be the largest pieces of work left
+	uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+	for (uint32_t i = 1; i < queueCount; ++i)
+	{
+		WorkQueue& victim = *m_queues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.m_mutex);
+		if (!victim.m_jobs.empty())
+		{
+			JobHandle job = std::move(victim.m_jobs.front());
+			victim.m_jobs.pop_front();
+			--m_queuedJobs;
+			return job;
+		}
+	}
+
+	//Background work only once no short job is left anywhere
+	if (background)
+	{
+		std::lock_guard<std::mutex> lock(m_backgroundQueue.m_mutex);
+		if (!m_backgroundQueue.m_jobs.empty())
+		{
+			JobHandle job = std::move(m_backgroundQueue.m_jobs.front());
+			m_backgroundQueue.m_jobs.pop_front();
+			--m_queuedBackgroundJobs;
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void vkUtil::JobSystem::Execute(const JobHandle& job)
+{
+	//A failed dependency already handed its exception over
+	if (!job->m_exception)
+	{
+		try
+		{
+			job->m_work();
+		}
+		catch (...)
+		{
+			job->m_exception = std::current_exception();
+		}
+	}
+
+	//Drop whatever the work captured
+	job->m_work = nullptr;
+
+	std::vector<JobHandle> dependents;
+	{
+		std::lock_guard<std::mutex> lock(job->m_mutex);
+		job->m_done = true;
+		dependents.swap(job->m_dependents);
+	}
+
+	for (JobHandle& dependent : dependents)
+	{
+		if (job->m_exception)
+		{
+			std::lock_guard<std::mutex> lock(dependent->m_mutex);
+			if (!dependent->m_exception)
+				dependent->m_exception = job->m_exception;
+		}
+
+		if (--dependent->m_pendingDependencies == 0)
+			Push(std::move(dependent));
+	}
+
+	if (m_sleepingWaiters > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_all();
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	class JobSystem;
+
+	/**
+		A scheduled job, only JobSystem looks inside
+	*/
+	class Job
+	{
+	private:
+		friend class JobSystem;
+
+		std::function<void()> m_work;
+
+		// Unfinished dependencies, plus one held by Schedule until the job is wired up
+		std::atomic<uint32_t> m_pendingDependencies{ 1 };
+		std::atomic<bool> m_done{ false };
+		std::exception_ptr m_exception;
+
+		// Long running, only ever picked up by worker threads
+		bool m_background{ false };
+
+		// Guards m_dependents against the job finishing while a dependent is added,
+		// and m_exception against failing dependencies
+		std::mutex m_mutex;
+		std::vector<std::shared_ptr<Job>> m_dependents;
+	};
+
+	using JobHandle = std::shared_ptr<Job>;
+
+	/**
+		Work stealing scheduler shared by every parallel part of the engine.
+		Each thread pushes and pops jobs at the back of its own deque, idle threads steal from the front of the others'.
+		Threads which wait on a job run other jobs in the meantime, so waiting inside a job never deadlocks.
+		Background jobs sit in a queue of their own which only idle workers take from, so a wait never gets stuck running one.
+	*/
+	class JobSystem
+	{
+	public:
+		/**
+			\param threadCount the number of threads running jobs, including threads waiting on jobs
+		*/
+		JobSystem(uint32_t threadCount);
+		~JobSystem();
+
+		/**
+			\returns the number of threads running jobs, including the calling thread
+		*/
+		uint32_t GetThreadCount() const;
+
+		/**
+			Schedule a job to run once all of its dependencies finished.
+			If a dependency threw, the job doesn't run and rethrows that exception instead.
+
+			\param work the job, called once from any thread
+			\param dependencies jobs which have to finish first, finished or empty handles are ignored
+			\returns a handle to wait on or to depend on
+		*/
+		JobHandle Schedule(std::function<void()> work, const std::vector<JobHandle>& dependencies = {});
+
+		/**
+			Schedule long running work, such as a pipeline compile, which nothing waits on every frame.
+			Only workers with no other jobs pick it up, threads waiting on other jobs never help with it.
+			Without worker threads, waiting threads run it after all.
+
+			\param work the job, called once from a worker thread
+			\returns a handle to wait on or to depend on
+		*/
+		JobHandle ScheduleBackground(std::function<void()> work);
+
+		/**
+			Run other jobs until a job finished. Rethrows what the job threw.
+
+			\param job the job to wait for, an empty handle returns immediately
+		*/
+		void Wait(const JobHandle& job);
+
+		/**
+			Run other jobs until every job of a batch finished.
+			Rethrows the first exception only then, so nothing still runs that might refer to the caller's locals.
+
+			\param jobs the jobs to wait for, empty handles are skipped
+		*/
+		void Wait(const std::vector<JobHandle>& jobs);
+
+		/**
+			\returns whether a job finished
+		*/
+		bool IsDone(const JobHandle& job) const;
+
+		/**
+			Run a batch of jobs and wait for all of them to finish, helping with them.
+
+			\param jobCount the number of jobs in the batch
+			\param job called once for every job index in [0, jobCount), from any thread
+		*/
+		void ParallelFor(uint32_t jobCount, const std::function<void(uint32_t)>& job);
+
+	private:
+		/**
+			One deque per worker, plus one shared by threads which aren't workers
+		*/
+		struct WorkQueue
+		{
+			std::mutex m_mutex;
+			std::deque<JobHandle> m_jobs;
+		};
+
+		std::vector<std::unique_ptr<WorkQueue>> m_queues;
+		std::vector<std::thread> m_workers;
+
+		// Background jobs, oldest first
+		WorkQueue m_backgroundQueue;
+
+		// Jobs sitting in any queue, sleepers wake when it's positive.
+		// Briefly negative when a job is taken before its push was counted.
+		std::atomic<int32_t> m_queuedJobs{ 0 };
+		std::atomic<int32_t> m_queuedBackgroundJobs{ 0 };
+
+		// Idle workers and waiting threads with nothing to help with sleep here,
+		// waiting threads also wake when any job finishes
+		std::mutex m_sleepMutex;
+		std::condition_variable m_wake;
+		std::atomic<uint32_t> m_sleepers{ 0 };
+		std::atomic<uint32_t> m_sleepingWaiters{ 0 };
+		bool m_stopping{ false };
+
+		void WorkerLoop(uint32_t queueIndex);
+
+		/**
+			\returns the queue owned by the calling thread
+		*/
+		uint32_t GetQueueIndex() const;
+
+		void Push(JobHandle job);
+
+		/**
+			Pop a job from the caller's queue, or steal one from another.
+
+			\param queueIndex the caller's queue
+			\param background whether to fall back to the background queue
+			\returns the job, empty if every queue was empty
+		*/
+		JobHandle Take(uint32_t queueIndex, bool background);
+
+		void Execute(const JobHandle& job);
+	};
+}
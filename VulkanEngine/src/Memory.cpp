@@ -1,5 +1,14 @@
 #include "Memory.h"
 
+namespace
+{
+	//Sizes of live allocations, so frees can be accounted without the caller knowing the size
+	std::mutex allocationMutex;
+	std::unordered_map<VkDeviceMemory, vk::DeviceSize> allocationSizes;
+	vk::DeviceSize allocatedMemory = 0;
+	vk::DeviceSize peakAllocatedMemory = 0;
+}
+
 uint32_t vkUtil::FindMemoryTypeIndex(vk::PhysicalDevice physicalDevice, uint32_t supportedMemoryIndices, vk::MemoryPropertyFlags requestedProperties)
 {
 	/*
@@ -58,10 +67,50 @@ void vkUtil::AllocatedBufferMemory(Buffer& buffer, const BufferInputChunk& input
 		memoryRequirements.memoryTypeBits,
 		input.m_memoryProperties);
 
-	buffer.m_bufferMemory = input.m_logicalDevice.allocateMemory(allocInfo);
+	buffer.m_bufferMemory = AllocateMemory(input.m_logicalDevice, allocInfo);
 	input.m_logicalDevice.bindBufferMemory(buffer.m_buffer, buffer.m_bufferMemory, 0);
 }
 
+vk::DeviceMemory vkUtil::AllocateMemory(vk::Device logicalDevice, const vk::MemoryAllocateInfo& allocInfo)
+{
+	vk::DeviceMemory memory = logicalDevice.allocateMemory(allocInfo);
+
+	std::lock_guard<std::mutex> lock(allocationMutex);
+	allocationSizes[static_cast<VkDeviceMemory>(memory)] = allocInfo.allocationSize;
+	allocatedMemory += allocInfo.allocationSize;
+	peakAllocatedMemory = std::max(peakAllocatedMemory, allocatedMemory);
+
+	return memory;
+}
+
+void vkUtil::FreeMemory(vk::Device logicalDevice, vk::DeviceMemory memory)
+{
+	if (!memory)
+		return;
+
+	logicalDevice.freeMemory(memory);
+
+	std::lock_guard<std::mutex> lock(allocationMutex);
+	auto allocation = allocationSizes.find(static_cast<VkDeviceMemory>(memory));
+	if (allocation != allocationSizes.end())
+	{
+		allocatedMemory -= allocation->second;
+		allocationSizes.erase(allocation);
+	}
+}
+
+vk::DeviceSize vkUtil::GetAllocatedMemory()
+{
+	std::lock_guard<std::mutex> lock(allocationMutex);
+	return allocatedMemory;
+}
+
+vk::DeviceSize vkUtil::GetPeakAllocatedMemory()
+{
+	std::lock_guard<std::mutex> lock(allocationMutex);
+	return peakAllocatedMemory;
+}
+
 Buffer vkUtil::CreateBuffer(BufferInputChunk input)
 {
 	/*
@@ -21,6 +21,33 @@ namespace vkUtil
 	*/
 	void AllocatedBufferMemory(Buffer& buffer, const BufferInputChunk& input);
 
+	/**
+		Allocate device memory, counted towards GetAllocatedMemory.
+
+		\param logicalDevice the device to allocate from
+		\param allocInfo the size and memory type to allocate
+		\returns the allocated memory
+	*/
+	vk::DeviceMemory AllocateMemory(vk::Device logicalDevice, const vk::MemoryAllocateInfo& allocInfo);
+
+	/**
+		Free memory from AllocateMemory. Null memory is ignored.
+
+		\param logicalDevice the device the memory was allocated from
+		\param memory the memory to free
+	*/
+	void FreeMemory(vk::Device logicalDevice, vk::DeviceMemory memory);
+
+	/**
+		\returns the bytes of device memory currently allocated through AllocateMemory
+	*/
+	vk::DeviceSize GetAllocatedMemory();
+
+	/**
+		\returns the most bytes of device memory allocated at once
+	*/
+	vk::DeviceSize GetPeakAllocatedMemory();
+
 	/**
 		Make a buffer.
 
@@ -1,9 +1,12 @@
 #include "ObjMesh.h"
+#include "CpuProfiler.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
 vkMesh::ObjMesh::ObjMesh(glm::mat4 preTransform, const char* objFilepath, const char* mtlFilepath)
 {
+	vkUtil::CpuZone zone("Load mesh");
+
 	//tinyobj::attrib_t attrib;
 	//std::vector<tinyobj::shape_t> shapes;
 	//std::vector<tinyobj::material_t> materials;
@@ -105,6 +108,8 @@ vkMesh::ObjMesh::ObjMesh(glm::mat4 preTransform, const char* objFilepath, const
 			ReadFaceData(words);
 		}
 	}
+
+	CalculateBounds();
 }
 
 void vkMesh::ObjMesh::ReadVertexData(const std::vector<std::string>& words)
@@ -179,3 +184,39 @@ void vkMesh::ObjMesh::ReadCorner(const std::string& vertexDescription)
 	m_vertices.push_back(normal[1]);
 	m_vertices.push_back(normal[2]);
 }
+
+
+void vkMesh::ObjMesh::CalculateBounds()
+{
+	// Vertices are interleaved as pos(3) color(3) texcoord(2) normal(3)
+	const size_t stride = 11;
+
+	if (m_vertices.empty())
+	{
+		m_bounds = { glm::vec3(0.f), glm::vec3(0.f), glm::vec3(0.f), 0.f };
+		return;
+	}
+
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+
+	for (size_t i = 0; i < m_vertices.size(); i += stride)
+	{
+		glm::vec3 pos(m_vertices[i], m_vertices[i + 1], m_vertices[i + 2]);
+		minimum = glm::min(minimum, pos);
+		maximum = glm::max(maximum, pos);
+	}
+
+	m_bounds.m_min = minimum;
+	m_bounds.m_max = maximum;
+	m_bounds.m_center = 0.5f * (minimum + maximum);
+
+	//Tighter than half the box diagonal for most meshes
+	float radiusSquared = 0.f;
+	for (size_t i = 0; i < m_vertices.size(); i += stride)
+	{
+		glm::vec3 offset = glm::vec3(m_vertices[i], m_vertices[i + 1], m_vertices[i + 2]) - m_bounds.m_center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	m_bounds.m_radius = std::sqrt(radiusSquared);
+}
\ No newline at end of file
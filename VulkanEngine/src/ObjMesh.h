@@ -1,5 +1,6 @@
 #pragma once
 #include "Config.h"
+#include "RenderStructs.h"
 
 namespace vkMesh 
 {
@@ -14,6 +15,7 @@ namespace vkMesh
 		std::unordered_map<std::string, glm::vec3> m_colorLookup;
 		glm::vec3 m_brushColor;
 		glm::mat4 m_preTransform;
+		vkUtil::MeshBounds m_bounds;
 
 		ObjMesh(glm::mat4 preTransform, const char* objFilepath, const char* mtlFilepath = "none");
 
@@ -26,5 +28,11 @@ namespace vkMesh
 		void ReadFaceData(const std::vector<std::string>& words); // read f
 
 		void ReadCorner(const std::string& vertex_description);
+
+		/**
+			Fit an axis aligned box and a bounding sphere around the
+			(pre-transformed) vertex positions.
+		*/
+		void CalculateBounds();
 	};
 }
\ No newline at end of file
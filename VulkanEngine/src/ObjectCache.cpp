@@ -0,0 +1,261 @@
+#include "ObjectCache.h"
+
+namespace
+{
+	/**
+		Keys are the raw bytes of an object's creation state, so equal keys
+		mean identical objects and hash collisions can't alias two objects.
+	*/
+	template<typename T>
+	void AppendKey(std::string& key, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Keys can only hold plain data");
+		key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void AppendKey(std::string& key, const std::string& value)
+	{
+		AppendKey(key, value.size());
+		key.append(value);
+	}
+
+	template<typename T>
+	void AppendKeyArray(std::string& key, const T* values, uint32_t count)
+	{
+		AppendKey(key, count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			AppendKey(key, values[i]);
+		}
+	}
+
+	void AppendKeyArray(std::string& key, const vk::DescriptorSetLayout* layouts, uint32_t count)
+	{
+		AppendKey(key, count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			AppendKey(key, static_cast<VkDescriptorSetLayout>(layouts[i]));
+		}
+	}
+
+	void AppendKey(std::string& key, const vk::SubpassDescription& subpass)
+	{
+		AppendKey(key, subpass.flags);
+		AppendKey(key, subpass.pipelineBindPoint);
+		AppendKeyArray(key, subpass.pInputAttachments, subpass.inputAttachmentCount);
+		AppendKeyArray(key, subpass.pColorAttachments, subpass.colorAttachmentCount);
+		AppendKey(key, subpass.pResolveAttachments != nullptr);
+		if (subpass.pResolveAttachments)
+		{
+			AppendKeyArray(key, subpass.pResolveAttachments, subpass.colorAttachmentCount);
+		}
+		AppendKey(key, subpass.pDepthStencilAttachment != nullptr);
+		if (subpass.pDepthStencilAttachment)
+		{
+			AppendKey(key, *subpass.pDepthStencilAttachment);
+		}
+		AppendKeyArray(key, subpass.pPreserveAttachments, subpass.preserveAttachmentCount);
+	}
+}
+
+vkInit::ObjectCache::ObjectCache(vk::Device device, vk::PipelineCache pipelineCache)
+	: m_device{ device },
+	m_pipelineCache{ pipelineCache }
+{
+}
+
+vkInit::ObjectCache::~ObjectCache()
+{
+	for (auto& [key, pipeline] : m_graphicsPipelines)
+	{
+		//Failed compiles hold an exception instead of a pipeline
+		try
+		{
+			m_device.destroyPipeline(pipeline.get().pipeline);
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+	for (auto& [key, pipeline] : m_computePipelines)
+	{
+		try
+		{
+			m_device.destroyPipeline(pipeline.get().pipeline);
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	for (const auto& [key, layout] : m_pipelineLayouts)
+	{
+		m_device.destroyPipelineLayout(layout);
+	}
+	for (const auto& [key, renderpass] : m_renderPasses)
+	{
+		m_device.destroyRenderPass(renderpass);
+	}
+	for (const auto& [key, layout] : m_descriptorSetLayouts)
+	{
+		m_device.destroyDescriptorSetLayout(layout);
+	}
+}
+
+vk::DescriptorSetLayout vkInit::ObjectCache::GetDescriptorSetLayout(const DescriptorSetLayoutData& bindings)
+{
+	std::string key;
+	AppendKey(key, bindings.m_count);
+	for (int i = 0; i < bindings.m_count; ++i)
+	{
+		AppendKey(key, bindings.m_indices[i]);
+		AppendKey(key, bindings.m_types[i]);
+		AppendKey(key, bindings.m_counts[i]);
+		AppendKey(key, bindings.m_stages[i]);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto layout = m_descriptorSetLayouts.find(key);
+	if (layout != m_descriptorSetLayouts.end())
+		return layout->second;
+
+	//Throws on failure, so a failed layout is never cached
+	vk::DescriptorSetLayout created = CreateDescriptorSetLayout(m_device, bindings);
+	m_descriptorSetLayoutData[static_cast<VkDescriptorSetLayout>(created)] = bindings;
+	return m_descriptorSetLayouts[key] = created;
+}
+
+const vkInit::DescriptorSetLayoutData& vkInit::ObjectCache::GetDescriptorSetLayoutData(vk::DescriptorSetLayout layout)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_descriptorSetLayoutData.at(static_cast<VkDescriptorSetLayout>(layout));
+}
+
+vk::PipelineLayout vkInit::ObjectCache::GetPipelineLayout(const vk::PipelineLayoutCreateInfo& layoutInfo)
+{
+	std::string key;
+	AppendKey(key, layoutInfo.flags);
+	AppendKeyArray(key, layoutInfo.pSetLayouts, layoutInfo.setLayoutCount);
+	AppendKeyArray(key, layoutInfo.pPushConstantRanges, layoutInfo.pushConstantRangeCount);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto layout = m_pipelineLayouts.find(key);
+	if (layout != m_pipelineLayouts.end())
+		return layout->second;
+
+	try
+	{
+		return m_pipelineLayouts[key] = m_device.createPipelineLayout(layoutInfo);
+	}
+	catch (vk::SystemError err)
+	{
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+}
+
+vk::RenderPass vkInit::ObjectCache::GetRenderPass(const vk::RenderPassCreateInfo& renderpassInfo)
+{
+	std::string key;
+	AppendKey(key, renderpassInfo.flags);
+	AppendKeyArray(key, renderpassInfo.pAttachments, renderpassInfo.attachmentCount);
+	AppendKey(key, renderpassInfo.subpassCount);
+	for (uint32_t i = 0; i < renderpassInfo.subpassCount; ++i)
+	{
+		AppendKey(key, renderpassInfo.pSubpasses[i]);
+	}
+	AppendKeyArray(key, renderpassInfo.pDependencies, renderpassInfo.dependencyCount);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto renderpass = m_renderPasses.find(key);
+	if (renderpass != m_renderPasses.end())
+		return renderpass->second;
+
+	try
+	{
+		return m_renderPasses[key] = m_device.createRenderPass(renderpassInfo);
+	}
+	catch (vk::SystemError err)
+	{
+		throw std::runtime_error("Failed to create renderpass!");
+	}
+}
+
+template<typename Bundle>
+Bundle vkInit::ObjectCache::FindOrBuild(std::unordered_map<std::string, std::shared_future<Bundle>>& pipelines,
+	const std::string& key, const std::function<Bundle()>& build)
+{
+	std::promise<Bundle> promise;
+	std::shared_future<Bundle> existing;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto pipeline = pipelines.find(key);
+		if (pipeline != pipelines.end())
+		{
+			existing = pipeline->second;
+		}
+		else
+		{
+			pipelines[key] = promise.get_future().share();
+		}
+	}
+
+	if (existing.valid())
+		return existing.get();
+
+	//Compile without holding the lock, so other pipelines can build meanwhile
+	try
+	{
+		Bundle bundle = build();
+		promise.set_value(bundle);
+		return bundle;
+	}
+	catch (...)
+	{
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+}
+
+vkInit::GraphicsPipelineOutBundle vkInit::ObjectCache::GetGraphicsPipeline(const GraphicsPipelineDescription& description)
+{
+	std::string key;
+	AppendKey(key, description.vertexShader);
+	AppendKey(key, description.fragmentShader);
+	AppendKey(key, description.bindingDescription.has_value());
+	if (description.bindingDescription)
+	{
+		AppendKey(key, *description.bindingDescription);
+	}
+	AppendKeyArray(key, description.attributeDescriptions.data(), static_cast<uint32_t>(description.attributeDescriptions.size()));
+	AppendKey(key, description.colorFormat);
+	AppendKey(key, description.colorLayout);
+	AppendKey(key, description.depthFormat.has_value());
+	if (description.depthFormat)
+	{
+		AppendKey(key, *description.depthFormat);
+	}
+	AppendKey(key, description.overwrite);
+	AppendKeyArray(key, description.descriptorSetLayouts.data(), static_cast<uint32_t>(description.descriptorSetLayouts.size()));
+	AppendKey(key, description.features);
+	AppendKey(key, description.sunColor);
+	AppendKey(key, description.sunDirection);
+
+	return FindOrBuild<GraphicsPipelineOutBundle>(m_graphicsPipelines, key, [&]()
+		{
+			return BuildGraphicsPipeline(m_device, description, m_pipelineCache, this);
+		});
+}
+
+vkInit::ComputePipelineOutBundle vkInit::ObjectCache::GetComputePipeline(const ComputePipelineDescription& description)
+{
+	std::string key;
+	AppendKey(key, description.computeShader);
+	AppendKeyArray(key, description.descriptorSetLayouts.data(), static_cast<uint32_t>(description.descriptorSetLayouts.size()));
+	AppendKey(key, description.pushConstantSize);
+
+	return FindOrBuild<ComputePipelineOutBundle>(m_computePipelines, key, [&]()
+		{
+			return BuildComputePipeline(m_device, description.computeShader.c_str(),
+				description.descriptorSetLayouts, description.pushConstantSize, m_pipelineCache, this);
+		});
+}
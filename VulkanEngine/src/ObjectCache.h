@@ -0,0 +1,85 @@
+#pragma once
+#include "Config.h"
+#include "Pipeline.h"
+#include "Descriptors.h"
+
+namespace vkInit
+{
+	/**
+		Hash-consed Vulkan objects: asking for an object whose description matches
+		one made before returns the existing object instead of creating another.
+		Objects are keyed by their full creation state, and owned by the cache.
+		Safe to use from several threads, pipelines compile concurrently.
+	*/
+	class ObjectCache
+	{
+	public:
+		ObjectCache(vk::Device device, vk::PipelineCache pipelineCache);
+
+		/**
+			Destroys every object the cache handed out, only once the device is idle.
+		*/
+		~ObjectCache();
+
+		/**
+			\param bindings a struct describing the bindings used in the shader
+			\returns a descriptor set layout with those bindings
+		*/
+		vk::DescriptorSetLayout GetDescriptorSetLayout(const DescriptorSetLayoutData& bindings);
+
+		/**
+			\param layout a descriptor set layout handed out by the cache
+			\returns the bindings it was made from, to size descriptor pools with
+		*/
+		const DescriptorSetLayoutData& GetDescriptorSetLayoutData(vk::DescriptorSetLayout layout);
+
+		/**
+			\param layoutInfo the set layouts and push constant ranges of the layout
+			\returns a pipeline layout matching the creation info
+		*/
+		vk::PipelineLayout GetPipelineLayout(const vk::PipelineLayoutCreateInfo& layoutInfo);
+
+		/**
+			\param renderpassInfo the attachments, subpasses and dependencies of the renderpass
+			\returns a renderpass matching the creation info
+		*/
+		vk::RenderPass GetRenderPass(const vk::RenderPassCreateInfo& renderpassInfo);
+
+		/**
+			Get a graphics pipeline, compiling it on the calling thread if it hasn't been yet.
+			A request for a pipeline another thread is compiling waits for that compile.
+
+			\param description the pipeline to build
+			\returns the pipeline, along with its renderpass and layout
+		*/
+		GraphicsPipelineOutBundle GetGraphicsPipeline(const GraphicsPipelineDescription& description);
+
+		/**
+			Get a compute pipeline, compiling it on the calling thread if it hasn't been yet.
+
+			\param description the pipeline to build
+			\returns the pipeline, along with its layout
+		*/
+		ComputePipelineOutBundle GetComputePipeline(const ComputePipelineDescription& description);
+
+	private:
+		vk::Device m_device;
+		vk::PipelineCache m_pipelineCache;
+
+		std::mutex m_mutex;
+		std::unordered_map<std::string, vk::DescriptorSetLayout> m_descriptorSetLayouts;
+		std::unordered_map<VkDescriptorSetLayout, DescriptorSetLayoutData> m_descriptorSetLayoutData;
+		std::unordered_map<std::string, vk::PipelineLayout> m_pipelineLayouts;
+		std::unordered_map<std::string, vk::RenderPass> m_renderPasses;
+		//Pipelines compile outside the lock, so entries are futures
+		std::unordered_map<std::string, std::shared_future<GraphicsPipelineOutBundle>> m_graphicsPipelines;
+		std::unordered_map<std::string, std::shared_future<ComputePipelineOutBundle>> m_computePipelines;
+
+		/**
+			Look up a pipeline by key, building it on this thread if nobody has yet.
+		*/
+		template<typename Bundle>
+		Bundle FindOrBuild(std::unordered_map<std::string, std::shared_future<Bundle>>& pipelines,
+			const std::string& key, const std::function<Bundle()>& build);
+	};
+}
@@ -1,6 +1,7 @@
 #include "Pipeline.h"
 #include "Shaders.h"
 #include "RenderStructs.h"
+#include "ObjectCache.h"
 
 vkInit::PipelineBuilder::PipelineBuilder(vk::Device device) 
 {
@@ -27,6 +28,7 @@ void vkInit::PipelineBuilder::Reset()
 
 	ResetVertexFormat();
 	ResetShaderModules();
+	ResetSpecialization();
 	ResetRenderPassAttachments();
 	ResetDescriptorSetLayouts();
 }
@@ -62,6 +64,16 @@ void vkInit::PipelineBuilder::SetOverwriteMode(bool mode)
 	overwrite = mode;
 }
 
+void vkInit::PipelineBuilder::SetPipelineCache(vk::PipelineCache pipelineCache)
+{
+	this->pipelineCache = pipelineCache;
+}
+
+void vkInit::PipelineBuilder::SetObjectCache(ObjectCache* objectCache)
+{
+	this->objectCache = objectCache;
+}
+
 void vkInit::PipelineBuilder::ResetShaderModules() 
 {
 	if (vertexShader) 
@@ -78,6 +90,52 @@ void vkInit::PipelineBuilder::ResetShaderModules()
 	shaderStages.clear();
 }
 
+void vkInit::PipelineBuilder::ResetSpecialization()
+{
+	specializationEntries.clear();
+	specializationData.clear();
+}
+
+void vkInit::PipelineBuilder::AddSpecializationConstant(uint32_t constantID, uint32_t value)
+{
+	for (const vk::SpecializationMapEntry& entry : specializationEntries)
+	{
+		if (entry.constantID == constantID)
+		{
+			specializationData[entry.offset / sizeof(uint32_t)] = value;
+			return;
+		}
+	}
+
+	vk::SpecializationMapEntry entry;
+	entry.constantID = constantID;
+	entry.offset = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+	entry.size = sizeof(uint32_t);
+	specializationEntries.push_back(entry);
+	specializationData.push_back(value);
+}
+
+void vkInit::PipelineBuilder::SpecifyVariant(uint32_t features)
+{
+	for (uint32_t feature = 0; feature < ShaderFeatures::Count; ++feature)
+	{
+		VkBool32 enabled = (features >> feature) & 1u ? VK_TRUE : VK_FALSE;
+		AddSpecializationConstant(feature, enabled);
+	}
+}
+
+void vkInit::PipelineBuilder::SpecifyConstant(uint32_t constantID, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	AddSpecializationConstant(constantID, bits);
+}
+
+void vkInit::PipelineBuilder::SpecifyConstant(uint32_t constantID, uint32_t value)
+{
+	AddSpecializationConstant(constantID, value);
+}
+
 void vkInit::PipelineBuilder::SpecifyVertexShader(const char* filename) 
 {
 	if (vertexShader) 
@@ -117,11 +175,6 @@ vk::PipelineShaderStageCreateInfo vkInit::PipelineBuilder::CreateShaderInfo(
 	return shaderInfo;
 }
 
-void vkInit::PipelineBuilder::SpecifySwapChainExtent(vk::Extent2D screen_size) 
-{
-	swapchainExtent = screen_size;
-}
-
 void vkInit::PipelineBuilder::SpecifyDepthAttachment(const vk::Format& depthFormat, uint32_t attachment_index) 
 {
 
@@ -149,7 +202,7 @@ void vkInit::PipelineBuilder::SpecifyDepthAttachment(const vk::Format& depthForm
 }
 
 void vkInit::PipelineBuilder::AddColorAttachment(
-const vk::Format& format, uint32_t attachment_index) 
+const vk::Format& format, uint32_t attachment_index, vk::ImageLayout layout) 
 {
 
 	vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eDontCare;
@@ -162,9 +215,9 @@ const vk::Format& format, uint32_t attachment_index)
 	vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
 	if (overwrite) 
 	{
-		initialLayout = vk::ImageLayout::ePresentSrcKHR;
+		initialLayout = layout;
 	}
-	vk::ImageLayout finalLayout = vk::ImageLayout::ePresentSrcKHR;
+	vk::ImageLayout finalLayout = layout;
 
 	attachmentDescriptions.insert({ attachment_index, CreateRenderPassAttachment(format, loadOp, storeOp, initialLayout, finalLayout) });
 	attachmentReferences.insert({ attachment_index, CreateAttachmentReference(attachment_index, vk::ImageLayout::eColorAttachmentOptimal) });
@@ -219,14 +272,24 @@ vkInit::GraphicsPipelineOutBundle vkInit::PipelineBuilder::Build()
 	//Input Assembly
 	pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
 
-	//Viewport and Scissor
+	//Viewport and Scissor, set while recording so resizes never rebuild the pipeline
 	CreateViewportState();
 	pipelineInfo.pViewportState = &viewportState;
+	CreateDynamicState();
+	pipelineInfo.pDynamicState = &dynamicState;
 
 	//Rasterizer
 	pipelineInfo.pRasterizationState = &rasterizer;
 
-	//Shader Modules
+	//Shader Modules, all specialized to the same variant
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+	specializationInfo.pData = specializationData.data();
+	for (vk::PipelineShaderStageCreateInfo& shaderStage : shaderStages)
+	{
+		shaderStage.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+	}
 	pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
 	pipelineInfo.pStages = shaderStages.data();
 
@@ -254,7 +317,7 @@ vkInit::GraphicsPipelineOutBundle vkInit::PipelineBuilder::Build()
 	vk::Pipeline graphicsPipeline;
 	try 
 	{
-		graphicsPipeline = (device.createGraphicsPipeline(nullptr, pipelineInfo)).value;
+		graphicsPipeline = (device.createGraphicsPipeline(pipelineCache, pipelineInfo)).value;
 	}
 	catch (vk::SystemError err) 
 	{
@@ -277,26 +340,27 @@ void vkInit::PipelineBuilder::ConfigureInputAssembly()
 
 vk::PipelineViewportStateCreateInfo vkInit::PipelineBuilder::CreateViewportState() 
 {
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)swapchainExtent.width;
-	viewport.height = (float)swapchainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent = swapchainExtent;
-
+	//Only the counts are baked in, the rectangles themselves are dynamic
 	viewportState.flags = vk::PipelineViewportStateCreateFlags();
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
+	viewportState.pViewports = nullptr;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.pScissors = nullptr;
 
 	return viewportState;
 }
 
+vk::PipelineDynamicStateCreateInfo vkInit::PipelineBuilder::CreateDynamicState()
+{
+	dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+
+	dynamicState.flags = vk::PipelineDynamicStateCreateFlags();
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	return dynamicState;
+}
+
 void vkInit::PipelineBuilder::CreateRasterizerInfo() 
 {
 	rasterizer.flags = vk::PipelineRasterizationStateCreateFlags();
@@ -354,6 +418,9 @@ vk::PipelineLayout vkInit::PipelineBuilder::CreatePipelineLayout()
 
 	layoutInfo.pushConstantRangeCount = 0;
 
+	if (objectCache)
+		return objectCache->GetPipelineLayout(layoutInfo);
+
 	try 
 	{
 		return device.createPipelineLayout(layoutInfo);
@@ -382,6 +449,9 @@ vk::RenderPass vkInit::PipelineBuilder::CreateRenderPass()
 	vk::SubpassDescription subpass = CreateSubpass(flattenedAttachmentReferences);
 	//Now create the renderpass
 	vk::RenderPassCreateInfo renderpassInfo = CreateRenderPassInfo(flattenedAttachmentDescriptions, subpass);
+	if (objectCache)
+		return objectCache->GetRenderPass(renderpassInfo);
+
 	try 
 	{
 		return device.createRenderPass(renderpassInfo);
@@ -422,4 +492,122 @@ vk::RenderPassCreateInfo vkInit::PipelineBuilder::CreateRenderPassInfo(const std
 	renderpassInfo.pSubpasses = &subpass;
 
 	return renderpassInfo;
-}
\ No newline at end of file
+}
+
+vkInit::ComputePipelineOutBundle vkInit::BuildComputePipeline(vk::Device device, const char* filename,
+	const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts, uint32_t pushConstantSize,
+	vk::PipelineCache pipelineCache, ObjectCache* objectCache)
+{
+	ComputePipelineOutBundle output;
+
+	vk::PushConstantRange pushConstantRange;
+	pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = pushConstantSize;
+
+	vk::PipelineLayoutCreateInfo layoutInfo;
+	layoutInfo.flags = vk::PipelineLayoutCreateFlags();
+	layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	layoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	layoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (objectCache)
+	{
+		output.layout = objectCache->GetPipelineLayout(layoutInfo);
+	}
+	else
+	{
+		try
+		{
+			output.layout = device.createPipelineLayout(layoutInfo);
+		}
+		catch (vk::SystemError err)
+		{
+			throw std::runtime_error("Failed to create compute pipeline layout!");
+		}
+	}
+
+	vk::ShaderModule computeShader = vkUtil::CreateModule(filename, device);
+
+	vk::ComputePipelineCreateInfo pipelineInfo;
+	pipelineInfo.flags = vk::PipelineCreateFlags();
+	pipelineInfo.stage.flags = vk::PipelineShaderStageCreateFlags();
+	pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+	pipelineInfo.stage.module = computeShader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = output.layout;
+	pipelineInfo.basePipelineHandle = nullptr;
+
+	try
+	{
+		output.pipeline = (device.createComputePipeline(pipelineCache, pipelineInfo)).value;
+	}
+	catch (vk::SystemError err)
+	{
+		device.destroyShaderModule(computeShader);
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+
+	//The module isn't needed once the pipeline is built
+	device.destroyShaderModule(computeShader);
+
+	return output;
+}
+vkInit::GraphicsPipelineOutBundle vkInit::BuildGraphicsPipeline(vk::Device device,
+	const GraphicsPipelineDescription& description, vk::PipelineCache pipelineCache, ObjectCache* objectCache)
+{
+	//A builder per pipeline, so concurrent builds share no mutable state
+	PipelineBuilder pipelineBuilder(device);
+	pipelineBuilder.SetPipelineCache(pipelineCache);
+	pipelineBuilder.SetObjectCache(objectCache);
+	pipelineBuilder.SetOverwriteMode(description.overwrite);
+
+	if (description.bindingDescription)
+	{
+		pipelineBuilder.SpecifyVertexFormat(*description.bindingDescription, description.attributeDescriptions);
+	}
+	pipelineBuilder.SpecifyVertexShader(description.vertexShader.c_str());
+	pipelineBuilder.SpecifyFragmentShader(description.fragmentShader.c_str());
+
+	pipelineBuilder.SpecifyVariant(description.features);
+	for (int i = 0; i < 3; ++i)
+	{
+		pipelineBuilder.SpecifyConstant(ShaderConstants::SunColor + i, description.sunColor[i]);
+		pipelineBuilder.SpecifyConstant(ShaderConstants::SunDirection + i, description.sunDirection[i]);
+	}
+	pipelineBuilder.SpecifyConstant(ShaderConstants::MaterialCount, MeshTypeCount);
+
+	if (description.depthFormat)
+	{
+		pipelineBuilder.SpecifyDepthAttachment(*description.depthFormat, 1);
+	}
+	else
+	{
+		pipelineBuilder.ClearDepthAttachment();
+	}
+
+	for (vk::DescriptorSetLayout descriptorSetLayout : description.descriptorSetLayouts)
+	{
+		pipelineBuilder.AddDescriptorSetLayout(descriptorSetLayout);
+	}
+	pipelineBuilder.AddColorAttachment(description.colorFormat, 0, description.colorLayout);
+
+	return pipelineBuilder.Build();
+}
+
+vkInit::PendingGraphicsPipeline vkInit::CompileGraphicsPipelineAsync(vkUtil::JobSystem& jobs, ObjectCache& objectCache, GraphicsPipelineDescription description)
+{
+	return PendingGraphicsPipeline(jobs, [&objectCache, description = std::move(description)]()
+		{
+			return objectCache.GetGraphicsPipeline(description);
+		});
+}
+
+vkInit::PendingComputePipeline vkInit::CompileComputePipelineAsync(vkUtil::JobSystem& jobs, ObjectCache& objectCache, ComputePipelineDescription description)
+{
+	return PendingComputePipeline(jobs, [&objectCache, description = std::move(description)]()
+		{
+			return objectCache.GetComputePipeline(description);
+		});
+}
@@ -1,9 +1,12 @@
 #pragma once
 #include "Config.h"
+#include "JobSystem.h"
 
 
 namespace vkInit
 {
+	class ObjectCache;
+
 	/**
 			Used for returning the pipeline, along with associated data structures,
 			after creation.
@@ -15,6 +18,145 @@ namespace vkInit
 		vk::Pipeline pipeline;
 	};
 
+	/**
+		Used for returning a compute pipeline, along with its layout,
+		after creation.
+	*/
+	struct ComputePipelineOutBundle
+	{
+		vk::PipelineLayout layout;
+		vk::Pipeline pipeline;
+	};
+
+	/**
+		Everything needed to build a graphics pipeline, as a plain value.
+		Holds no builder state, so descriptions can be compiled on any thread.
+	*/
+	struct GraphicsPipelineDescription
+	{
+		std::string vertexShader;
+		std::string fragmentShader;
+		std::optional<vk::VertexInputBindingDescription> bindingDescription;
+		std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
+		vk::Format colorFormat;
+		//Layout of the color image outside the renderpass
+		vk::ImageLayout colorLayout = vk::ImageLayout::ePresentSrcKHR;
+		std::optional<vk::Format> depthFormat;
+		bool overwrite = false;
+		std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+
+		//Shader variant, see ShaderFeatures
+		uint32_t features = ShaderFeatures::All;
+		glm::vec3 sunColor = glm::vec3(1.0f, 1.0f, 1.0f);
+		glm::vec3 sunDirection = glm::vec3(1.0f, 1.0f, -1.0f);
+	};
+
+	/**
+		Everything needed to build a compute pipeline, as a plain value.
+	*/
+	struct ComputePipelineDescription
+	{
+		std::string computeShader;
+		std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+		uint32_t pushConstantSize = 0;
+	};
+
+	/**
+		Handle to a pipeline compiling in the job system's background queue. Get waits for the pipeline,
+		running other short jobs meanwhile, and rethrows if it failed to build.
+	*/
+	template<typename Bundle>
+	class PendingPipeline
+	{
+	public:
+		PendingPipeline() = default;
+
+		/**
+			\param jobs the job system to compile on
+			\param build compiles the pipeline, called once from any thread
+		*/
+		PendingPipeline(vkUtil::JobSystem& jobs, std::function<Bundle()> build)
+			: m_jobs{ &jobs },
+			m_bundle{ std::make_shared<Bundle>() }
+		{
+			//The result is written before the job counts as done, so a finished job's bundle is safe to read
+			m_job = jobs.ScheduleBackground([bundle = m_bundle, build = std::move(build)]() { *bundle = build(); });
+		}
+
+		/**
+			\returns whether the pipeline has finished compiling, without waiting
+		*/
+		bool IsReady() const
+		{
+			return m_jobs->IsDone(m_job);
+		}
+
+		/**
+			\returns the compiled pipeline, waiting for it if needed
+		*/
+		Bundle Get() const
+		{
+			m_jobs->Wait(m_job);
+			return *m_bundle;
+		}
+
+	private:
+		vkUtil::JobSystem* m_jobs{ nullptr };
+		vkUtil::JobHandle m_job;
+		std::shared_ptr<Bundle> m_bundle;
+	};
+
+	using PendingGraphicsPipeline = PendingPipeline<GraphicsPipelineOutBundle>;
+	using PendingComputePipeline = PendingPipeline<ComputePipelineOutBundle>;
+
+	/**
+		Make a graphics pipeline from a description, along with renderpass and pipeline layout
+
+		\param device the logical device
+		\param description the pipeline to build
+		\param pipelineCache the pipeline cache to compile through
+		\param objectCache supplies the renderpass and layout, or nullptr to create new ones
+		\returns the bundle of data structures created
+	*/
+	GraphicsPipelineOutBundle BuildGraphicsPipeline(vk::Device device,
+		const GraphicsPipelineDescription& description, vk::PipelineCache pipelineCache, ObjectCache* objectCache);
+
+	/**
+		Start compiling a graphics pipeline on the job system.
+		Pipeline caches are internally synchronized, so compiles may share one.
+
+		\param jobs the job system to compile on
+		\param objectCache the cache to fetch the pipeline from, compiling it if it's new
+		\param description the pipeline to build, copied
+		\returns a handle to the pipeline being compiled
+	*/
+	PendingGraphicsPipeline CompileGraphicsPipelineAsync(vkUtil::JobSystem& jobs, ObjectCache& objectCache, GraphicsPipelineDescription description);
+
+	/**
+		Start compiling a compute pipeline on the job system.
+
+		\param jobs the job system to compile on
+		\param objectCache the cache to fetch the pipeline from, compiling it if it's new
+		\param description the pipeline to build, copied
+		\returns a handle to the pipeline being compiled
+	*/
+	PendingComputePipeline CompileComputePipelineAsync(vkUtil::JobSystem& jobs, ObjectCache& objectCache, ComputePipelineDescription description);
+
+	/**
+		Make a compute pipeline, along with its pipeline layout
+
+		\param device the logical device
+		\param filename the spir-v file holding the compute shader
+		\param descriptorSetLayouts the descriptor set layouts used by the shader
+		\param pushConstantSize the size (in bytes) of the push constant block, 0 for none
+		\param pipelineCache the pipeline cache to compile through
+		\param objectCache supplies the layout, or nullptr to create a new one
+		\returns the bundle of data structures created
+	*/
+	ComputePipelineOutBundle BuildComputePipeline(vk::Device device, const char* filename,
+		const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts, uint32_t pushConstantSize,
+		vk::PipelineCache pipelineCache, ObjectCache* objectCache);
+
 	class PipelineBuilder 
 	{
 	public:
@@ -40,16 +182,62 @@ namespace vkInit
 
 		void SpecifyFragmentShader(const char* filename);
 
-		void SpecifySwapChainExtent(vk::Extent2D screen_size);
+		/**
+			Select the shader variant to compile, every shader stage is specialized with it.
+
+			\param features bitmask of ShaderFeatures, bit n sets boolean specialization constant n
+		*/
+		void SpecifyVariant(uint32_t features);
+
+		/**
+			Set a numeric specialization constant of every shader stage.
+			Ids the shaders don't declare are ignored.
+
+			\param constantID the constant_id in the shaders
+			\param value the value to compile with
+		*/
+		void SpecifyConstant(uint32_t constantID, float value);
+
+		/**
+			Set an integer specialization constant of every shader stage, such as an array size.
+			Ids the shaders don't declare are ignored.
+
+			\param constantID the constant_id in the shaders
+			\param value the value to compile with
+		*/
+		void SpecifyConstant(uint32_t constantID, uint32_t value);
 
 		void SpecifyDepthAttachment(const vk::Format& depthFormat, uint32_t attachment_index);
 
 		void ClearDepthAttachment();
 
-		void AddColorAttachment(const vk::Format& format, uint32_t attachment_index);
+		/**
+			Add a color attachment, which is left in the given layout after the renderpass
+			(and expected in it beforehand, in overwrite mode).
+
+			\param format the image format
+			\param attachment_index the attachment's index in the renderpass
+			\param layout ePresentSrcKHR for swapchain images, eTransferSrcOptimal for offscreen images
+		*/
+		void AddColorAttachment(const vk::Format& format, uint32_t attachment_index, vk::ImageLayout layout);
 
 		void SetOverwriteMode(bool mode);
 
+		/**
+			Compile through a pipeline cache, kept across Reset.
+
+			\param pipelineCache the cache to use, or nullptr for none
+		*/
+		void SetPipelineCache(vk::PipelineCache pipelineCache);
+
+		/**
+			Share renderpasses and layouts through an object cache, kept across Reset.
+			Objects from the cache are owned by it, not the caller.
+
+			\param objectCache the cache to use, or nullptr to create new objects
+		*/
+		void SetObjectCache(ObjectCache* objectCache);
+
 		/**
 			Make a graphics pipeline, along with renderpass and pipeline layout
 
@@ -64,6 +252,8 @@ namespace vkInit
 
 	private:
 		vk::Device device;
+		vk::PipelineCache pipelineCache = nullptr;
+		ObjectCache* objectCache = nullptr;
 		vk::GraphicsPipelineCreateInfo pipelineInfo = {};
 
 		vk::VertexInputBindingDescription bindingDescription;
@@ -75,10 +265,13 @@ namespace vkInit
 		vk::ShaderModule vertexShader = nullptr, fragmentShader = nullptr;
 		vk::PipelineShaderStageCreateInfo vertexShaderInfo, fragmentShaderInfo;
 
-		vk::Extent2D swapchainExtent;
-		vk::Viewport viewport = {};
-		vk::Rect2D scissor = {};
+		std::vector<vk::SpecializationMapEntry> specializationEntries;
+		std::vector<uint32_t> specializationData;
+		vk::SpecializationInfo specializationInfo = {};
+
 		vk::PipelineViewportStateCreateInfo viewportState = {};
+		std::vector<vk::DynamicState> dynamicStates;
+		vk::PipelineDynamicStateCreateInfo dynamicState = {};
 
 		vk::PipelineRasterizationStateCreateInfo rasterizer = {};
 
@@ -100,6 +293,13 @@ namespace vkInit
 
 		void ResetShaderModules();
 
+		void ResetSpecialization();
+
+		/**
+			Add a 32 bit specialization constant, replacing an earlier value for the same id.
+		*/
+		void AddSpecializationConstant(uint32_t constantID, uint32_t value);
+
 		void ResetRenderPassAttachments();
 
 		/**
@@ -135,14 +335,21 @@ namespace vkInit
 			const vk::ShaderModule& shaderModule, const vk::ShaderStageFlagBits& stage);
 
 		/**
-			Configure the pipeline's viewport stage.
+			Configure the pipeline's viewport stage. The viewport and scissor
+			rectangles are dynamic, so only their counts are specified here.
 
-			\param viewport the viewport specification
-			\param scissor the scissor rectangle to apply
 			\returns the viewport state creation info
 		*/
 		vk::PipelineViewportStateCreateInfo CreateViewportState();
 
+		/**
+			Mark the viewport and scissor as dynamic state, they must be set
+			with vkCmdSetViewport/vkCmdSetScissor in every command buffer that draws.
+
+			\returns the dynamic state creation info
+		*/
+		vk::PipelineDynamicStateCreateInfo CreateDynamicState();
+
 		/**
 			sets the creation info for the configured rasterizer stage
 		*/
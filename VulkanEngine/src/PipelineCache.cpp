@@ -0,0 +1,164 @@
+#include "PipelineCache.h"
+
+namespace
+{
+	constexpr uint32_t pipelineCacheMagic = 0x4C56504Cu; //"LPVL"
+
+	/**
+		Prefixed to the driver's own data. The driver's header carries no
+		driver version, so a driver update would otherwise reuse a stale cache.
+	*/
+	struct PipelineCacheFileHeader
+	{
+		uint32_t m_magic;
+		uint32_t m_dataSize;
+		uint32_t m_vendorID;
+		uint32_t m_deviceID;
+		uint32_t m_driverVersion;
+		uint8_t m_pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	/**
+		The header Vulkan puts at the start of every pipeline cache's data.
+	*/
+	struct DriverCacheHeader
+	{
+		uint32_t m_headerSize;
+		uint32_t m_headerVersion;
+		uint32_t m_vendorID;
+		uint32_t m_deviceID;
+		uint8_t m_pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	bool MatchesDevice(uint32_t vendorID, uint32_t deviceID, const uint8_t* pipelineCacheUUID, const vk::PhysicalDeviceProperties& properties)
+	{
+		return vendorID == properties.vendorID
+			&& deviceID == properties.deviceID
+			&& std::equal(pipelineCacheUUID, pipelineCacheUUID + VK_UUID_SIZE, properties.pipelineCacheUUID.begin());
+	}
+
+	/**
+		Read a cache file, returning its driver data only if it was written for this device.
+	*/
+	std::vector<char> ReadCacheFile(const char* filename, const vk::PhysicalDeviceProperties& properties, bool debug)
+	{
+		std::ifstream file(filename, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			if (debug)
+				std::cout << "No pipeline cache at \"" << filename << "\", starting empty" << std::endl;
+			return {};
+		}
+
+		size_t fileSize{ static_cast<size_t>(file.tellg()) };
+		if (fileSize < sizeof(PipelineCacheFileHeader) + sizeof(DriverCacheHeader))
+		{
+			if (debug)
+				std::cout << "Pipeline cache \"" << filename << "\" is truncated, starting empty" << std::endl;
+			return {};
+		}
+
+		PipelineCacheFileHeader header;
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		if (header.m_magic != pipelineCacheMagic
+			|| header.m_dataSize != fileSize - sizeof(header)
+			|| header.m_driverVersion != properties.driverVersion
+			|| !MatchesDevice(header.m_vendorID, header.m_deviceID, header.m_pipelineCacheUUID, properties))
+		{
+			if (debug)
+				std::cout << "Pipeline cache \"" << filename << "\" was written for another device or driver, starting empty" << std::endl;
+			return {};
+		}
+
+		std::vector<char> data(header.m_dataSize);
+		file.read(data.data(), data.size());
+
+		//The driver validates its own header too, but a corrupt file shouldn't reach it
+		DriverCacheHeader driverHeader;
+		std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+		if (driverHeader.m_headerVersion != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne)
+			|| !MatchesDevice(driverHeader.m_vendorID, driverHeader.m_deviceID, driverHeader.m_pipelineCacheUUID, properties))
+		{
+			if (debug)
+				std::cout << "Pipeline cache \"" << filename << "\" has an invalid driver header, starting empty" << std::endl;
+			return {};
+		}
+
+		return data;
+	}
+}
+
+vk::PipelineCache vkInit::CreatePipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, const char* filename, bool debug)
+{
+	std::vector<char> data = ReadCacheFile(filename, physicalDevice.getProperties(), debug);
+
+	vk::PipelineCacheCreateInfo cacheInfo;
+	cacheInfo.flags = vk::PipelineCacheCreateFlags();
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.data();
+
+	try
+	{
+		vk::PipelineCache pipelineCache = device.createPipelineCache(cacheInfo);
+		if (debug && !data.empty())
+			std::cout << "Seeded pipeline cache with " << data.size() << " bytes from \"" << filename << "\"" << std::endl;
+		return pipelineCache;
+	}
+	catch (vk::SystemError err)
+	{
+		if (debug)
+			std::cout << "Failed to seed pipeline cache, starting empty" << std::endl;
+	}
+
+	cacheInfo.initialDataSize = 0;
+	cacheInfo.pInitialData = nullptr;
+	try
+	{
+		return device.createPipelineCache(cacheInfo);
+	}
+	catch (vk::SystemError err)
+	{
+		throw std::runtime_error("Failed to create pipeline cache");
+	}
+}
+
+void vkInit::SavePipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, vk::PipelineCache pipelineCache, const char* filename, bool debug)
+{
+	std::vector<uint8_t> data;
+	try
+	{
+		data = device.getPipelineCacheData(pipelineCache);
+	}
+	catch (vk::SystemError err)
+	{
+		if (debug)
+			std::cout << "Failed to read back the pipeline cache" << std::endl;
+		return;
+	}
+
+	vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+
+	PipelineCacheFileHeader header;
+	header.m_magic = pipelineCacheMagic;
+	header.m_dataSize = static_cast<uint32_t>(data.size());
+	header.m_vendorID = properties.vendorID;
+	header.m_deviceID = properties.deviceID;
+	header.m_driverVersion = properties.driverVersion;
+	std::copy(properties.pipelineCacheUUID.begin(), properties.pipelineCacheUUID.end(), header.m_pipelineCacheUUID);
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		if (debug)
+			std::cout << "Failed to write pipeline cache \"" << filename << "\"" << std::endl;
+		return;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+	if (debug)
+		std::cout << "Wrote " << data.size() << " bytes of pipeline cache to \"" << filename << "\"" << std::endl;
+}
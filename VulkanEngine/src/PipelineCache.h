@@ -0,0 +1,29 @@
+#pragma once
+#include "Config.h"
+
+namespace vkInit
+{
+	/**
+		Make a pipeline cache, seeded from a file written by a previous run.
+		The file is only used if it was written for the same vendor, device and
+		driver, anything else starts an empty cache.
+
+		\param device the logical device
+		\param physicalDevice the physical device
+		\param filename the file to seed the cache from
+		\param debug whether the system is running in debug mode
+		\returns the created pipeline cache
+	*/
+	vk::PipelineCache CreatePipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, const char* filename, bool debug);
+
+	/**
+		Write a pipeline cache's contents to disk, for the next run to seed from.
+
+		\param device the logical device
+		\param physicalDevice the physical device
+		\param pipelineCache the pipeline cache to write
+		\param filename the file to write
+		\param debug whether the system is running in debug mode
+	*/
+	void SavePipelineCache(vk::Device device, vk::PhysicalDevice physicalDevice, vk::PipelineCache pipelineCache, const char* filename, bool debug);
+}
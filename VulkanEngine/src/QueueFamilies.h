@@ -23,6 +23,7 @@ namespace vkUtil
 	/**
 		Find suitable queue family indices on the given physical device.
 		\param device the physical device to check
+		\param surface the surface to present to, nullptr when headless
 		\param debug whether the system is running in debug mode
 		\returns a struct holding the queue family indices
 	*/
@@ -76,7 +77,12 @@ namespace vkUtil
 					std::cout << "Queue Family " << i << " is suitable for graphics" << std::endl;
 			}
 
-			if (device.getSurfaceSupportKHR(i, surface))
+			if (!surface)
+			{
+				//Headless, nothing is presented
+				indices.presentFamily = indices.graphicsFamily;
+			}
+			else if (device.getSurfaceSupportKHR(i, surface))
 			{
 				indices.presentFamily = i;
 
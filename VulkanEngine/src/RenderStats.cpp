@@ -0,0 +1,37 @@
+#include "RenderStats.h"
+
+vkUtil::RenderStats& vkUtil::RenderStats::operator+=(const RenderStats& other)
+{
+	m_drawCalls += other.m_drawCalls;
+	m_draws += other.m_draws;
+	m_instances += other.m_instances;
+	m_triangles += other.m_triangles;
+	m_dispatches += other.m_dispatches;
+
+	m_pipelineBinds += other.m_pipelineBinds;
+	m_descriptorSetBinds += other.m_descriptorSetBinds;
+	m_vertexBufferBinds += other.m_vertexBufferBinds;
+	m_indexBufferBinds += other.m_indexBufferBinds;
+
+	m_mappedBytesWritten += other.m_mappedBytesWritten;
+	m_bufferUpdateBytes += other.m_bufferUpdateBytes;
+
+	m_renderPasses += other.m_renderPasses;
+	return *this;
+}
+
+void vkUtil::WriteRenderStatsJson(std::ostream& stream, const RenderStats& stats, double scale)
+{
+	stream << "{\"draw_calls\":" << stats.m_drawCalls * scale
+		<< ",\"draws\":" << stats.m_draws * scale
+		<< ",\"instances\":" << stats.m_instances * scale
+		<< ",\"triangles\":" << stats.m_triangles * scale
+		<< ",\"dispatches\":" << stats.m_dispatches * scale
+		<< ",\"pipeline_binds\":" << stats.m_pipelineBinds * scale
+		<< ",\"descriptor_set_binds\":" << stats.m_descriptorSetBinds * scale
+		<< ",\"vertex_buffer_binds\":" << stats.m_vertexBufferBinds * scale
+		<< ",\"index_buffer_binds\":" << stats.m_indexBufferBinds * scale
+		<< ",\"mapped_bytes_written\":" << stats.m_mappedBytesWritten * scale
+		<< ",\"buffer_update_bytes\":" << stats.m_bufferUpdateBytes * scale
+		<< ",\"render_passes\":" << stats.m_renderPasses * scale << "}";
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Config.h"
+
+namespace vkUtil
+{
+	/**
+		What the renderer did in one frame, counted while recording.
+		With GPU culling, instances and triangles are counted before culling,
+		the survivors are only known on the GPU.
+	*/
+	struct RenderStats
+	{
+		// Draw commands recorded, an indirect call counts once however many draws it holds
+		uint64_t m_drawCalls{ 0 };
+		// Draws executed, each draw of an indirect call counts
+		uint64_t m_draws{ 0 };
+		uint64_t m_instances{ 0 };
+		uint64_t m_triangles{ 0 };
+		uint64_t m_dispatches{ 0 };
+
+		uint64_t m_pipelineBinds{ 0 };
+		uint64_t m_descriptorSetBinds{ 0 };
+		uint64_t m_vertexBufferBinds{ 0 };
+		uint64_t m_indexBufferBinds{ 0 };
+
+		// Bytes the CPU wrote into persistently mapped buffers
+		uint64_t m_mappedBytesWritten{ 0 };
+		// Bytes recorded inline into command buffers through updateBuffer
+		uint64_t m_bufferUpdateBytes{ 0 };
+
+		uint64_t m_renderPasses{ 0 };
+
+		RenderStats& operator+=(const RenderStats& other);
+	};
+
+	/**
+		Write the counters as a JSON object, without a trailing newline.
+
+		\param stream the stream to write to
+		\param stats the counters to write
+		\param scale multiplies every counter, 1 / frameCount turns totals into per frame averages
+	*/
+	void WriteRenderStatsJson(std::ostream& stream, const RenderStats& stats, double scale = 1.0);
+}
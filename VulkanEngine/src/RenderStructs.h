@@ -7,4 +7,68 @@ namespace vkUtil
 	{
 		glm::mat4 model;
 	};
+
+	/**
+		Model space bounds of a mesh, an axis aligned box
+		along with the sphere enclosing it.
+	*/
+	struct MeshBounds
+	{
+		glm::vec3 m_min;
+		glm::vec3 m_max;
+		glm::vec3 m_center;
+		float m_radius;
+	};
+
+	/**
+		Push constants for the culling compute shader.
+	*/
+	struct CullParameters
+	{
+		glm::vec4 m_planes[6];
+		uint32_t m_instanceCount;
+	};
+
+	/**
+		Compact transform of one instance, expanded into its model matrix by expand.comp.
+		The rotation is a quaternion quantized to snorm16, x and y in m_rotationXY, z and w in m_rotationZW.
+		Laid out like the std430 struct in expand.comp and scatter.comp.
+	*/
+	struct InstanceData
+	{
+		glm::vec3 m_position;
+		uint32_t m_rotationXY;
+		glm::vec3 m_scale;
+		uint32_t m_rotationZW;
+	};
+
+	/**
+		A changed instance and the instance buffer slot it goes to,
+		laid out like the std430 struct in scatter.comp.
+	*/
+	struct TransformUpload
+	{
+		InstanceData m_instance;
+		uint32_t m_slot;
+		uint32_t m_padding[3];
+	};
+
+	/**
+		Push constants for the transform scatter compute shader.
+	*/
+	struct ScatterParameters
+	{
+		uint32_t m_uploadCount;
+	};
+
+	/**
+		Push constants for the instance expansion compute shader.
+		With m_useSlots set, m_instanceCount slots are read from the slot list,
+		otherwise the first m_instanceCount instances are expanded.
+	*/
+	struct ExpandParameters
+	{
+		uint32_t m_instanceCount;
+		uint32_t m_useSlots;
+	};
 }
\ No newline at end of file
@@ -2,14 +2,264 @@
 
 Scene::Scene()
 {
-	m_positions.insert({ MeshTypes::GROUND, {} });
-	m_positions.insert({ MeshTypes::GIRL, {} });
-	m_positions.insert({ MeshTypes::SKULL, {} });
-	m_positions.insert({ MeshTypes::ROOM, {} });
-
-	m_positions[MeshTypes::GROUND].push_back(glm::vec3(10.f, 0.f, 0.f));
-	m_positions[MeshTypes::GIRL].push_back(glm::vec3(14.f, 0.f, 0.f));
-	//m_positions[MeshTypes::ROOM].push_back(glm::vec3(5.f, 0.f, 0.f));
-	m_positions[MeshTypes::SKULL].push_back(glm::vec3(10.f, -5.f, 0.f));
-	m_positions[MeshTypes::SKULL].push_back(glm::vec3(10.f, 5.f, 0.f));
+	AddInstance(MeshTypes::GROUND, glm::vec3(10.f, 0.f, 0.f));
+	AddInstance(MeshTypes::GIRL, glm::vec3(14.f, 0.f, 0.f));
+	//AddInstance(MeshTypes::ROOM, glm::vec3(5.f, 0.f, 0.f));
+	AddInstance(MeshTypes::SKULL, glm::vec3(10.f, -5.f, 0.f));
+	AddInstance(MeshTypes::SKULL, glm::vec3(10.f, 5.f, 0.f));
+}
+
+InstanceHandle Scene::AddInstance(MeshTypes meshType, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	uint32_t meshIndex = static_cast<uint32_t>(meshType);
+	uint32_t hole = GetInstanceCount();
+
+	m_positions.emplace_back();
+	m_rotations.emplace_back();
+	m_scales.emplace_back();
+	m_meshes.emplace_back();
+	m_materials.emplace_back();
+	m_slotHandles.emplace_back();
+
+	//Walk the gap down from the end: every later mesh type moves its first instance past its last
+	for (uint32_t later = MeshTypeCount - 1; later > meshIndex; --later)
+	{
+		MeshRange& range = m_meshRanges[later];
+		if (range.m_count > 0)
+		{
+			MoveSlot(range.m_first, hole);
+			hole = range.m_first;
+		}
+		++range.m_first;
+	}
+
+	InstanceHandle handle;
+	if (m_freeHandles.empty())
+	{
+		handle.m_index = static_cast<uint32_t>(m_handleSlots.size());
+		m_handleSlots.push_back(hole);
+		m_handleGenerations.push_back(0);
+	}
+	else
+	{
+		handle.m_index = m_freeHandles.back();
+		m_freeHandles.pop_back();
+		m_handleSlots[handle.m_index] = hole;
+	}
+	handle.m_generation = m_handleGenerations[handle.m_index];
+
+	m_positions[hole] = position;
+	m_rotations[hole] = rotation;
+	m_scales[hole] = scale;
+	m_meshes[hole] = meshType;
+	//Each mesh type's material until instances get materials of their own
+	m_materials[hole] = meshIndex;
+	m_slotHandles[hole] = handle.m_index;
+	++m_meshRanges[meshIndex].m_count;
+
+	//Slots of the following mesh types moved, consumers rewrite everything
+	++m_layoutVersion;
+
+	return handle;
+}
+
+void Scene::RemoveInstance(InstanceHandle handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	uint32_t slot = m_handleSlots[handle.m_index];
+	uint32_t meshIndex = static_cast<uint32_t>(m_meshes[slot]);
+
+	++m_handleGenerations[handle.m_index];
+	m_freeHandles.push_back(handle.m_index);
+
+	//Swap remove within the mesh type, then walk the gap up to the end:
+	//every later mesh type moves its last instance in front of its first
+	MeshRange& range = m_meshRanges[meshIndex];
+	uint32_t last = range.m_first + range.m_count - 1;
+	if (slot != last)
+		MoveSlot(last, slot);
+	--range.m_count;
+
+	for (uint32_t later = meshIndex + 1; later < MeshTypeCount; ++later)
+	{
+		MeshRange& laterRange = m_meshRanges[later];
+		--laterRange.m_first;
+		if (laterRange.m_count > 0)
+			MoveSlot(laterRange.m_first + laterRange.m_count, laterRange.m_first);
+	}
+
+	m_positions.pop_back();
+	m_rotations.pop_back();
+	m_scales.pop_back();
+	m_meshes.pop_back();
+	m_materials.pop_back();
+	m_slotHandles.pop_back();
+
+	++m_layoutVersion;
+}
+
+void Scene::Clear()
+{
+	for (uint32_t handleIndex : m_slotHandles)
+	{
+		++m_handleGenerations[handleIndex];
+		m_freeHandles.push_back(handleIndex);
+	}
+
+	m_positions.clear();
+	m_rotations.clear();
+	m_scales.clear();
+	m_meshes.clear();
+	m_materials.clear();
+	m_slotHandles.clear();
+	m_meshRanges.fill(MeshRange());
+
+	++m_layoutVersion;
+
+	//Changes refer to instances which are gone, cursors handed out stay valid
+	m_changeBase += m_changes.size();
+	m_changes.clear();
+}
+
+bool Scene::IsValid(InstanceHandle handle) const
+{
+	return handle.m_index < m_handleGenerations.size() && m_handleGenerations[handle.m_index] == handle.m_generation;
+}
+
+void Scene::SetPosition(InstanceHandle handle, const glm::vec3& position)
+{
+	uint32_t slot = GetSlot(handle);
+	m_positions[slot] = position;
+	m_changes.push_back(slot);
+}
+
+void Scene::SetRotation(InstanceHandle handle, const glm::quat& rotation)
+{
+	uint32_t slot = GetSlot(handle);
+	m_rotations[slot] = rotation;
+	m_changes.push_back(slot);
+}
+
+void Scene::SetScale(InstanceHandle handle, const glm::vec3& scale)
+{
+	uint32_t slot = GetSlot(handle);
+	m_scales[slot] = scale;
+	m_changes.push_back(slot);
+}
+
+void Scene::SetTransform(InstanceHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	uint32_t slot = GetSlot(handle);
+	m_positions[slot] = position;
+	m_rotations[slot] = rotation;
+	m_scales[slot] = scale;
+	m_changes.push_back(slot);
+}
+
+uint32_t Scene::GetSlot(InstanceHandle handle) const
+{
+	return m_handleSlots[handle.m_index];
+}
+
+InstanceHandle Scene::GetHandle(uint32_t slot) const
+{
+	InstanceHandle handle;
+	handle.m_index = m_slotHandles[slot];
+	handle.m_generation = m_handleGenerations[handle.m_index];
+	return handle;
+}
+
+uint32_t Scene::GetInstanceCount() const
+{
+	return static_cast<uint32_t>(m_positions.size());
+}
+
+MeshRange Scene::GetMeshRange(MeshTypes meshType) const
+{
+	return m_meshRanges[static_cast<uint32_t>(meshType)];
+}
+
+const glm::vec3* Scene::GetPositions() const
+{
+	return m_positions.data();
+}
+
+const glm::quat* Scene::GetRotations() const
+{
+	return m_rotations.data();
+}
+
+const glm::vec3* Scene::GetScales() const
+{
+	return m_scales.data();
+}
+
+const MeshTypes* Scene::GetMeshes() const
+{
+	return m_meshes.data();
+}
+
+const uint32_t* Scene::GetMaterials() const
+{
+	return m_materials.data();
+}
+
+uint64_t Scene::GetLayoutVersion() const
+{
+	return m_layoutVersion;
+}
+
+uint64_t Scene::GetChangeCursor() const
+{
+	return m_changeBase + m_changes.size();
+}
+
+bool Scene::GetChangesSince(uint64_t cursor, const uint32_t*& changes, uint32_t& count) const
+{
+	if (cursor < m_changeBase)
+		return false;
+
+	uint64_t offset = cursor - m_changeBase;
+	changes = m_changes.data() + offset;
+	count = static_cast<uint32_t>(m_changes.size() - offset);
+	return true;
+}
+
+void Scene::TrimChanges(uint64_t cursor)
+{
+	if (cursor <= m_changeBase)
+		return;
+
+	uint64_t trimmed = std::min<uint64_t>(cursor - m_changeBase, m_changes.size());
+	m_changes.erase(m_changes.begin(), m_changes.begin() + trimmed);
+	m_changeBase += trimmed;
+}
+
+void Scene::SetCamera(const glm::vec3& eye, const glm::vec3& target)
+{
+	m_cameraEye = eye;
+	m_cameraTarget = target;
+}
+
+const glm::vec3& Scene::GetCameraEye() const
+{
+	return m_cameraEye;
+}
+
+const glm::vec3& Scene::GetCameraTarget() const
+{
+	return m_cameraTarget;
+}
+
+void Scene::MoveSlot(uint32_t from, uint32_t to)
+{
+	m_positions[to] = m_positions[from];
+	m_rotations[to] = m_rotations[from];
+	m_scales[to] = m_scales[from];
+	m_meshes[to] = m_meshes[from];
+	m_materials[to] = m_materials[from];
+	m_slotHandles[to] = m_slotHandles[from];
+	m_handleSlots[m_slotHandles[to]] = to;
 }
@@ -1,10 +1,168 @@
 #pragma once
 #include "Config.h"
 
+/**
+	Refers to an instance for as long as it lives. Slots move when other instances come and go,
+	handles don't, and a handle to a removed instance is detected instead of hitting its successor.
+*/
+struct InstanceHandle
+{
+	uint32_t m_index{ std::numeric_limits<uint32_t>::max() };
+	uint32_t m_generation{ 0 };
+};
+
+/**
+	The contiguous run of slots holding the instances of one mesh type
+*/
+struct MeshRange
+{
+	uint32_t m_first{ 0 };
+	uint32_t m_count{ 0 };
+};
+
+/**
+	Instance storage as parallel arrays indexed by slot, slots grouped by mesh type in MeshTypes order.
+	The slot of an instance is also its index in the GPU instance buffers.
+*/
 class Scene
 {
 public:
 	Scene();
-	
-	std::unordered_map<MeshTypes, std::vector<glm::vec3>> m_positions;
-};
\ No newline at end of file
+
+	/**
+		Add an instance. Moves one instance of every later mesh type, so every transform has to be rewritten.
+
+		\param meshType the mesh to draw
+		\param position world space position of the instance
+		\param rotation world space orientation of the instance
+		\param scale per axis scale of the instance
+		\returns a handle to the instance
+	*/
+	InstanceHandle AddInstance(MeshTypes meshType, const glm::vec3& position,
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	/**
+		Remove an instance, filling its slot with the last one of its mesh type.
+		Moves one instance of every later mesh type, so every transform has to be rewritten.
+
+		\param handle the instance to remove, ignored if no longer valid
+	*/
+	void RemoveInstance(InstanceHandle handle);
+
+	/**
+		Remove every instance, invalidating every handle.
+	*/
+	void Clear();
+
+	/**
+		\returns whether the handle still refers to a live instance
+	*/
+	bool IsValid(InstanceHandle handle) const;
+
+	/**
+		Move, turn or scale an instance, recording the change.
+
+		\param handle a valid handle to the instance
+	*/
+	void SetPosition(InstanceHandle handle, const glm::vec3& position);
+	void SetRotation(InstanceHandle handle, const glm::quat& rotation);
+	void SetScale(InstanceHandle handle, const glm::vec3& scale);
+	void SetTransform(InstanceHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	/**
+		\param handle a valid handle to the instance
+		\returns the instance's slot, valid until instances are added or removed
+	*/
+	uint32_t GetSlot(InstanceHandle handle) const;
+
+	/**
+		\returns the handle of the instance in a slot
+	*/
+	InstanceHandle GetHandle(uint32_t slot) const;
+
+	/**
+		\returns the total number of instances across all mesh types
+	*/
+	uint32_t GetInstanceCount() const;
+
+	/**
+		\returns the slots holding the instances of a mesh type
+	*/
+	MeshRange GetMeshRange(MeshTypes meshType) const;
+
+	// Per slot attributes, GetInstanceCount entries each
+	const glm::vec3* GetPositions() const;
+	const glm::quat* GetRotations() const;
+	const glm::vec3* GetScales() const;
+	const MeshTypes* GetMeshes() const;
+	const uint32_t* GetMaterials() const;
+
+	/**
+		\returns a counter bumped whenever instances are added or removed, invalidating every slot
+	*/
+	uint64_t GetLayoutVersion() const;
+
+	/**
+		\returns the position just past the newest recorded change
+	*/
+	uint64_t GetChangeCursor() const;
+
+	/**
+		Get the slots changed since a cursor, oldest first. A slot may appear more than once.
+		Slots logged before the latest layout change are stale.
+
+		\param cursor a value previously returned by GetChangeCursor
+		\param changes receives the first changed slot, valid until the next modification of the scene
+		\param count receives the number of changes
+		\returns false if changes after the cursor were already trimmed
+	*/
+	bool GetChangesSince(uint64_t cursor, const uint32_t*& changes, uint32_t& count) const;
+
+	/**
+		Forget the changes before a cursor, once no consumer needs them anymore.
+
+		\param cursor the oldest cursor still in use
+	*/
+	void TrimChanges(uint64_t cursor);
+
+	/**
+		Place the camera, z is up.
+
+		\param eye world space position of the camera
+		\param target world space point the camera looks at
+	*/
+	void SetCamera(const glm::vec3& eye, const glm::vec3& target);
+
+	const glm::vec3& GetCameraEye() const;
+	const glm::vec3& GetCameraTarget() const;
+
+private:
+	glm::vec3 m_cameraEye{ -1.0f, 0.0f, 5.0f };
+	glm::vec3 m_cameraTarget{ 1.0f, 0.0f, 5.0f };
+
+	// Instance attributes by slot
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::quat> m_rotations;
+	std::vector<glm::vec3> m_scales;
+	std::vector<MeshTypes> m_meshes;
+	std::vector<uint32_t> m_materials;
+	std::vector<uint32_t> m_slotHandles;
+
+	std::array<MeshRange, MeshTypeCount> m_meshRanges{};
+
+	// Slot and generation by handle index, freed handle indices are reused
+	std::vector<uint32_t> m_handleSlots;
+	std::vector<uint32_t> m_handleGenerations;
+	std::vector<uint32_t> m_freeHandles;
+
+	uint64_t m_layoutVersion{ 0 };
+
+	// m_changes[0] sits at cursor m_changeBase
+	std::vector<uint32_t> m_changes;
+	uint64_t m_changeBase{ 0 };
+
+	/**
+		Move the instance in one slot to another, overwriting the destination.
+	*/
+	void MoveSlot(uint32_t from, uint32_t to);
+};
@@ -0,0 +1,315 @@
+#include "SceneCapture.h"
+
+namespace
+{
+	constexpr char captureMagic[4] = { 'L', 'V', 'S', 'C' };
+	constexpr uint32_t captureVersion = 2;
+
+	/**
+		Every record starts with one of these, a frame is a run of records closed by END_FRAME.
+		Instances are identified by the index of their handle in the recorded scene.
+	*/
+	enum class CaptureOp : uint8_t
+	{
+		CLEAR,		// remove every instance
+		ADD,		// uint32_t id, uint8_t mesh type, vec3 position, quat rotation, vec3 scale
+		REMOVE,		// uint32_t id
+		MOVE,		// uint32_t id, vec3 position, quat rotation, vec3 scale
+		CAMERA,		// vec3 eye, vec3 target
+		RESIZE,		// int32_t width, int32_t height
+		END_FRAME
+	};
+
+	/**
+		\returns the size of the data following an op, or nothing for an unknown op
+	*/
+	std::optional<size_t> GetPayloadSize(CaptureOp op)
+	{
+		switch (op)
+		{
+		case CaptureOp::CLEAR:
+		case CaptureOp::END_FRAME:
+			return 0;
+		case CaptureOp::ADD:
+			return sizeof(uint32_t) + sizeof(uint8_t) + 2 * sizeof(glm::vec3) + sizeof(glm::quat);
+		case CaptureOp::REMOVE:
+			return sizeof(uint32_t);
+		case CaptureOp::MOVE:
+			return sizeof(uint32_t) + 2 * sizeof(glm::vec3) + sizeof(glm::quat);
+		case CaptureOp::CAMERA:
+			return 2 * sizeof(glm::vec3);
+		case CaptureOp::RESIZE:
+			return 2 * sizeof(int32_t);
+		default:
+			return std::nullopt;
+		}
+	}
+}
+
+SceneRecorder::SceneRecorder(const std::string& filename)
+	: m_file(filename, std::ios::binary)
+{
+	if (!m_file.is_open())
+		throw std::runtime_error("Failed to create scene capture \"" + filename + "\"");
+
+	m_file.write(captureMagic, sizeof(captureMagic));
+	Write(captureVersion);
+}
+
+void SceneRecorder::CaptureFrame(const Scene& scene, int width, int height)
+{
+	const uint32_t* changes = nullptr;
+	uint32_t changeCount = 0;
+
+	if (m_frameCount == 0 || scene.GetLayoutVersion() != m_layoutVersion
+		|| !scene.GetChangesSince(m_changeCursor, changes, changeCount))
+	{
+		WriteLayoutChanges(scene);
+	}
+	else
+	{
+		//An instance may be logged more than once, only transforms which really changed are written
+		for (uint32_t i = 0; i < changeCount; ++i)
+		{
+			WriteMove(scene, changes[i]);
+		}
+	}
+
+	m_layoutVersion = scene.GetLayoutVersion();
+	m_changeCursor = scene.GetChangeCursor();
+
+	if (m_frameCount == 0 || scene.GetCameraEye() != m_cameraEye || scene.GetCameraTarget() != m_cameraTarget)
+	{
+		m_cameraEye = scene.GetCameraEye();
+		m_cameraTarget = scene.GetCameraTarget();
+		Write(CaptureOp::CAMERA);
+		Write(m_cameraEye);
+		Write(m_cameraTarget);
+	}
+
+	if (m_frameCount == 0 || width != m_width || height != m_height)
+	{
+		m_width = width;
+		m_height = height;
+		Write(CaptureOp::RESIZE);
+		Write(static_cast<int32_t>(m_width));
+		Write(static_cast<int32_t>(m_height));
+	}
+
+	Write(CaptureOp::END_FRAME);
+	++m_frameCount;
+}
+
+uint32_t SceneRecorder::GetFrameCount() const
+{
+	return m_frameCount;
+}
+
+void SceneRecorder::WriteLayoutChanges(const Scene& scene)
+{
+	uint32_t instanceCount = scene.GetInstanceCount();
+
+	//The first frame always starts from scratch, so replays don't depend on the scene they start with
+	if (m_frameCount == 0 || (instanceCount == 0 && m_liveCount > 0))
+	{
+		Write(CaptureOp::CLEAR);
+		m_instances.clear();
+		m_liveCount = 0;
+	}
+
+	//Removes go first, a reused handle index is a removal followed by an add
+	for (uint32_t id = 0; id < m_instances.size(); ++id)
+	{
+		RecordedInstance& recorded = m_instances[id];
+		if (recorded.m_live && !scene.IsValid(InstanceHandle{ id, recorded.m_generation }))
+		{
+			recorded.m_live = false;
+			--m_liveCount;
+			Write(CaptureOp::REMOVE);
+			Write(id);
+		}
+	}
+
+	//Slots moved, so every instance is diffed against its recorded transform
+	const glm::vec3* positions = scene.GetPositions();
+	const glm::quat* rotations = scene.GetRotations();
+	const glm::vec3* scales = scene.GetScales();
+	const MeshTypes* meshes = scene.GetMeshes();
+
+	for (uint32_t slot = 0; slot < instanceCount; ++slot)
+	{
+		InstanceHandle handle = scene.GetHandle(slot);
+		if (handle.m_index >= m_instances.size())
+			m_instances.resize(handle.m_index + 1);
+
+		RecordedInstance& recorded = m_instances[handle.m_index];
+		if (recorded.m_live)
+		{
+			WriteMove(scene, slot);
+			continue;
+		}
+
+		recorded.m_live = true;
+		recorded.m_generation = handle.m_generation;
+		recorded.m_position = positions[slot];
+		recorded.m_rotation = rotations[slot];
+		recorded.m_scale = scales[slot];
+		++m_liveCount;
+
+		Write(CaptureOp::ADD);
+		Write(handle.m_index);
+		Write(static_cast<uint8_t>(meshes[slot]));
+		Write(recorded.m_position);
+		Write(recorded.m_rotation);
+		Write(recorded.m_scale);
+	}
+}
+
+void SceneRecorder::WriteMove(const Scene& scene, uint32_t slot)
+{
+	uint32_t id = scene.GetHandle(slot).m_index;
+	const glm::vec3& position = scene.GetPositions()[slot];
+	const glm::quat& rotation = scene.GetRotations()[slot];
+	const glm::vec3& scale = scene.GetScales()[slot];
+
+	RecordedInstance& recorded = m_instances[id];
+	if (recorded.m_position == position && recorded.m_rotation == rotation && recorded.m_scale == scale)
+		return;
+
+	recorded.m_position = position;
+	recorded.m_rotation = rotation;
+	recorded.m_scale = scale;
+	Write(CaptureOp::MOVE);
+	Write(id);
+	Write(position);
+	Write(rotation);
+	Write(scale);
+}
+
+SceneReplay::SceneReplay(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open scene capture \"" + filename + "\"");
+
+	m_data.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(m_data.data(), m_data.size());
+
+	if (m_data.size() < sizeof(captureMagic) || memcmp(m_data.data(), captureMagic, sizeof(captureMagic)) != 0)
+		throw std::runtime_error("\"" + filename + "\" is not a scene capture");
+
+	m_cursor = sizeof(captureMagic);
+	m_end = m_data.size();
+	if (Read<uint32_t>() != captureVersion)
+		throw std::runtime_error("Scene capture \"" + filename + "\" has an unsupported version");
+	m_firstFrame = m_cursor;
+
+	//Count the complete frames, a recording which was cut short ends with a partial one
+	size_t end = m_firstFrame;
+	for (size_t position = m_firstFrame; position < m_data.size();)
+	{
+		CaptureOp op = static_cast<CaptureOp>(m_data[position]);
+		std::optional<size_t> payloadSize = GetPayloadSize(op);
+		if (!payloadSize)
+			throw std::runtime_error("Scene capture \"" + filename + "\" is corrupt");
+
+		position += 1 + *payloadSize;
+		if (op == CaptureOp::END_FRAME && position <= m_data.size())
+		{
+			end = position;
+			++m_frameCount;
+		}
+	}
+	m_end = end;
+}
+
+uint32_t SceneReplay::GetFrameCount() const
+{
+	return m_frameCount;
+}
+
+bool SceneReplay::NextFrame(Scene& scene, int& width, int& height)
+{
+	if (m_cursor >= m_end)
+		return false;
+
+	while (true)
+	{
+		CaptureOp op = Read<CaptureOp>();
+		switch (op)
+		{
+		case CaptureOp::CLEAR:
+			scene.Clear();
+			m_handles.clear();
+			break;
+
+		case CaptureOp::ADD:
+		{
+			uint32_t id = Read<uint32_t>();
+			uint8_t meshType = Read<uint8_t>();
+			glm::vec3 position = Read<glm::vec3>();
+			glm::quat rotation = Read<glm::quat>();
+			glm::vec3 scale = Read<glm::vec3>();
+			if (meshType >= MeshTypeCount || id == std::numeric_limits<uint32_t>::max())
+				throw std::runtime_error("Scene capture is corrupt");
+
+			if (id >= m_handles.size())
+				m_handles.resize(id + 1);
+			if (scene.IsValid(m_handles[id]))
+				throw std::runtime_error("Scene capture is corrupt");
+
+			m_handles[id] = scene.AddInstance(static_cast<MeshTypes>(meshType), position, rotation, scale);
+			break;
+		}
+
+		case CaptureOp::REMOVE:
+			scene.RemoveInstance(GetHandle(scene, Read<uint32_t>()));
+			break;
+
+		case CaptureOp::MOVE:
+		{
+			InstanceHandle handle = GetHandle(scene, Read<uint32_t>());
+			glm::vec3 position = Read<glm::vec3>();
+			glm::quat rotation = Read<glm::quat>();
+			glm::vec3 scale = Read<glm::vec3>();
+			scene.SetTransform(handle, position, rotation, scale);
+			break;
+		}
+
+		case CaptureOp::CAMERA:
+		{
+			glm::vec3 eye = Read<glm::vec3>();
+			glm::vec3 target = Read<glm::vec3>();
+			scene.SetCamera(eye, target);
+			break;
+		}
+
+		case CaptureOp::RESIZE:
+			m_width = Read<int32_t>();
+			m_height = Read<int32_t>();
+			break;
+
+		case CaptureOp::END_FRAME:
+			width = m_width;
+			height = m_height;
+			return true;
+
+		default:
+			throw std::runtime_error("Scene capture is corrupt");
+		}
+	}
+}
+
+void SceneReplay::Rewind()
+{
+	m_cursor = m_firstFrame;
+}
+
+InstanceHandle SceneReplay::GetHandle(const Scene& scene, uint32_t id) const
+{
+	if (id >= m_handles.size() || !scene.IsValid(m_handles[id]))
+		throw std::runtime_error("Scene capture is corrupt");
+
+	return m_handles[id];
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "Config.h"
+#include "Scene.h"
+
+/**
+	Records a session frame by frame into a compact binary file: instance adds, removes and moves,
+	scene clears, the camera and the window size. Only what changed since the previous frame is written.
+*/
+class SceneRecorder
+{
+public:
+	/**
+		\param filename the capture file to create, throws if it can't be opened
+	*/
+	SceneRecorder(const std::string& filename);
+
+	/**
+		Record the scene as it is about to be rendered. Call once per frame, before Render.
+
+		\param scene the scene being rendered
+		\param width the width of the rendered frame
+		\param height the height of the rendered frame
+	*/
+	void CaptureFrame(const Scene& scene, int width, int height);
+
+	/**
+		\returns the number of frames captured so far
+	*/
+	uint32_t GetFrameCount() const;
+
+private:
+	std::ofstream m_file;
+	uint32_t m_frameCount{ 0 };
+
+	/**
+		An instance as of the previous frame, by handle index
+	*/
+	struct RecordedInstance
+	{
+		bool m_live{ false };
+		uint32_t m_generation{ 0 };
+		glm::vec3 m_position{ 0.0f };
+		glm::quat m_rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+		glm::vec3 m_scale{ 1.0f };
+	};
+
+	// Diffed against when instances were added, removed or cleared
+	std::vector<RecordedInstance> m_instances;
+	uint32_t m_liveCount{ 0 };
+	uint64_t m_layoutVersion{ std::numeric_limits<uint64_t>::max() };
+	uint64_t m_changeCursor{ 0 };
+
+	glm::vec3 m_cameraEye{ 0.0f };
+	glm::vec3 m_cameraTarget{ 0.0f };
+	int m_width{ 0 };
+	int m_height{ 0 };
+
+	void WriteLayoutChanges(const Scene& scene);
+	void WriteMove(const Scene& scene, uint32_t slot);
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		m_file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+};
+
+/**
+	Plays a capture from SceneRecorder back into a scene, frame for frame.
+*/
+class SceneReplay
+{
+public:
+	/**
+		\param filename the capture file to load, throws if it can't be read or isn't a capture
+	*/
+	SceneReplay(const std::string& filename);
+
+	/**
+		\returns the number of frames in the capture
+	*/
+	uint32_t GetFrameCount() const;
+
+	/**
+		Apply the next frame's changes to the scene.
+
+		\param scene the scene to update, the first frame replaces whatever it held
+		\param width receives the width of the recorded frame
+		\param height receives the height of the recorded frame
+		\returns false once every frame was played
+	*/
+	bool NextFrame(Scene& scene, int& width, int& height);
+
+	/**
+		Start over from the first frame.
+	*/
+	void Rewind();
+
+private:
+	std::vector<char> m_data;
+	size_t m_cursor{ 0 };
+	// Just past the last complete frame, a recording cut short still plays up to there
+	size_t m_end{ 0 };
+	size_t m_firstFrame{ 0 };
+	uint32_t m_frameCount{ 0 };
+
+	int m_width{ 0 };
+	int m_height{ 0 };
+
+	// The scene's handle for each recorded id
+	std::vector<InstanceHandle> m_handles;
+
+	/**
+		\returns the scene's handle for a recorded id, throws if it doesn't refer to a live instance
+	*/
+	InstanceHandle GetHandle(const Scene& scene, uint32_t id) const;
+
+	template <typename T>
+	T Read()
+	{
+		if (m_cursor + sizeof(T) > m_end)
+			throw std::runtime_error("Scene capture is corrupt");
+
+		T value;
+		memcpy(&value, m_data.data() + m_cursor, sizeof(T));
+		m_cursor += sizeof(T);
+		return value;
+	}
+};
@@ -14,9 +14,10 @@ namespace vkUtil
 	{
 		std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
+		//SPIR-V isn't checked in, a missing file means the shaders weren't compiled yet
 		if (!file.is_open()) 
 		{
-			std::cout << "Failed to load \"" << filename << "\"" << std::endl;
+			throw std::runtime_error("Failed to load \"" + filename + "\", compile the shaders with the project build, compile.bat or compile.sh");
 		}
 
 		size_t filesize{ static_cast<size_t>(file.tellg()) };
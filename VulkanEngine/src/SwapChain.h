@@ -26,9 +26,11 @@ namespace vkInit {
 	struct SwapChainBundle 
 	{
 		vk::SwapchainKHR swapchain;
-		std::vector<vkUtil::SwapChainFrame> frames;
+		std::vector<vkUtil::SwapChainImage> frames;
 		vk::Format format;
 		vk::Extent2D extent;
+		vk::PresentModeKHR presentMode;
+		std::vector<vk::PresentModeKHR> supportedPresentModes;
 	};
 
 	/**
@@ -136,12 +138,16 @@ namespace vkInit {
 		
 		// Logging Present Mode information
 
-		//support.presentModes = device.getSurfacePresentModesKHR(surface);
+		support.presentModes = device.getSurfacePresentModesKHR(surface);
 
-		//for (vk::PresentModeKHR presentMode : support.presentModes) 
-		//{
-		//	std::cout << '\t' << LogPresentMode(presentMode) << '\n';
-		//}
+		if (debug)
+		{
+			std::cout << "supported present modes:\n";
+			for (vk::PresentModeKHR presentMode : support.presentModes) 
+			{
+				std::cout << '\t' << LogPresentMode(presentMode) << '\n';
+			}
+		}
 		return support;
 	}
 
@@ -167,13 +173,14 @@ namespace vkInit {
 	/**
 		Choose a present mode.
 		\param presentModes a vector of present modes supported by the device
-		\returns the chosen present mode
+		\param requestedPresentMode the preferred present mode
+		\returns the requested present mode if supported, otherwise FIFO, which is always available
 	*/
-	vk::PresentModeKHR ChooseSwapChainPresentMode(std::vector<vk::PresentModeKHR> presentModes) 
+	vk::PresentModeKHR ChooseSwapChainPresentMode(const std::vector<vk::PresentModeKHR>& presentModes, vk::PresentModeKHR requestedPresentMode) 
 	{
 		for (vk::PresentModeKHR presentMode : presentModes) 
 		{
-			if (presentMode == vk::PresentModeKHR::eMailbox) 
+			if (presentMode == requestedPresentMode) 
 			{
 				return presentMode;
 			}
@@ -220,20 +227,25 @@ namespace vkInit {
 		\param surface the window surface to use the swapchain with
 		\param width the requested width
 		\param height the requested height
+		\param requestedPresentMode the preferred present mode, falls back to FIFO
+		\param oldSwapChain the swapchain being replaced, lets the driver hand over its resources, may be null
 		\param debug whether the system is running in debug mode
 		\returns a struct holding the swapchain and other associated data structures
 	*/
-	SwapChainBundle CreateSwapChain(vk::Device logicalDevice, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, int width, int height, bool debug) 
+	SwapChainBundle CreateSwapChain(vk::Device logicalDevice, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, int width, int height, vk::PresentModeKHR requestedPresentMode, vk::SwapchainKHR oldSwapChain, bool debug) 
 	{
 		SwapChainSupportDetails support = QuerySwapChainSupport(physicalDevice, surface, debug);
 
 		vk::SurfaceFormatKHR format = ChooseSwapChainSurfaceFormat(support.formats);
 
-		vk::PresentModeKHR presentMode = ChooseSwapChainPresentMode(support.presentModes);
+		vk::PresentModeKHR presentMode = ChooseSwapChainPresentMode(support.presentModes, requestedPresentMode);
 
 		vk::Extent2D extent = ChooseSwapChainExtent(width, height, support.capabilities);
 
-		uint32_t imageCount = std::min(	support.capabilities.maxImageCount, support.capabilities.minImageCount + 1);
+		//A maximum of 0 means there is no limit
+		uint32_t imageCount = support.capabilities.minImageCount + 1;
+		if (support.capabilities.maxImageCount > 0)
+			imageCount = std::min(support.capabilities.maxImageCount, imageCount);
 
 		/*
 		* VULKAN_HPP_CONSTEXPR SwapchainCreateInfoKHR(
@@ -289,7 +301,7 @@ namespace vkInit {
 		swapChainCreateInfo.presentMode = presentMode;
 		swapChainCreateInfo.clipped = VK_TRUE;
 
-		swapChainCreateInfo.oldSwapchain = vk::SwapchainKHR(nullptr);
+		swapChainCreateInfo.oldSwapchain = oldSwapChain;
 
 		SwapChainBundle bundle{};
 		try 
@@ -342,6 +354,8 @@ namespace vkInit {
 
 		bundle.format = format.format;
 		bundle.extent = extent;
+		bundle.presentMode = presentMode;
+		bundle.supportedPresentModes = support.presentModes;
 
 		return bundle;
 	}
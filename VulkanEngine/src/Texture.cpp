@@ -3,6 +3,7 @@
 #include "Memory.h"
 #include "Logging.h"
 #include "Descriptors.h"
+#include "CpuProfiler.h"
 
 vkImage::Texture::Texture(TextureInputChunk input) :
 	m_logicalDevice{ input.m_logicalDevice },
@@ -10,9 +11,12 @@ vkImage::Texture::Texture(TextureInputChunk input) :
 	m_filename{ input.m_filenames[0]},
 	m_commandBuffer{ input.m_commandBuffer },
 	m_queue{ input.m_queue },
+	m_uploadMutex{ input.m_uploadMutex },
 	m_layout{ input.m_layout },
 	m_descriptorPool{ input.m_descriptorPool }
 {
+	vkUtil::CpuZone zone("Load texture");
+
 	Load();
 
 	ImageInputChunk imageInput;
@@ -29,6 +33,11 @@ vkImage::Texture::Texture(TextureInputChunk input) :
 	m_image = CreateImage(imageInput);
 	m_imageMemory = CreateImageMemory(imageInput, m_image);
 
+	//Decoding above runs in parallel, but the command buffer, queue and descriptor pool may be shared
+	std::unique_lock<std::mutex> uploadLock;
+	if (m_uploadMutex)
+		uploadLock = std::unique_lock<std::mutex>(*m_uploadMutex);
+
 	Populate();
 
 	free(m_pixels);
@@ -37,12 +46,14 @@ vkImage::Texture::Texture(TextureInputChunk input) :
 
 	CreateSampler();
 
-	CreateDescriptorSet();
+	//Textures gathered into a material array don't need their own set
+	if (m_layout)
+		CreateDescriptorSet();
 }
 
 vkImage::Texture::~Texture()
 {
-	m_logicalDevice.freeMemory(m_imageMemory);
+	vkUtil::FreeMemory(m_logicalDevice, m_imageMemory);
 	m_logicalDevice.destroyImage(m_image);
 	m_logicalDevice.destroyImageView(m_imageView);
 	m_logicalDevice.destroySampler(m_sampler);
@@ -97,7 +108,7 @@ void vkImage::Texture::Populate()
 	TransitionImageLayout(transitionJob);
 
 	//Now the staging buffer can be destroyed
-	m_logicalDevice.freeMemory(stagingBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(m_logicalDevice, stagingBuffer.m_bufferMemory);
 	m_logicalDevice.destroyBuffer(stagingBuffer.m_buffer);
 }
 
@@ -162,15 +173,22 @@ void vkImage::Texture::CreateSampler() {
 
 }
 
-void vkImage::Texture::CreateDescriptorSet() {
-
-	m_descriptorSet = vkInit::AllocateDescriptorSet(m_logicalDevice, m_descriptorPool, m_layout);
-
+vk::DescriptorImageInfo vkImage::Texture::GetImageDescriptor() const
+{
 	vk::DescriptorImageInfo imageDescriptor;
 	imageDescriptor.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
 	imageDescriptor.imageView = m_imageView;
 	imageDescriptor.sampler = m_sampler;
 
+	return imageDescriptor;
+}
+
+void vkImage::Texture::CreateDescriptorSet() {
+
+	m_descriptorSet = vkInit::AllocateDescriptorSet(m_logicalDevice, m_descriptorPool, m_layout);
+
+	vk::DescriptorImageInfo imageDescriptor = GetImageDescriptor();
+
 	vk::WriteDescriptorSet descriptorWrite;
 	descriptorWrite.dstSet = m_descriptorSet;
 	descriptorWrite.dstBinding = 0;
@@ -10,6 +10,11 @@ namespace vkImage
 		Texture(TextureInputChunk input);
 
 		void Use(vk::CommandBuffer commandBuffer, vk::PipelineLayout pipelineLayout);
+
+		/**
+			\returns the descriptor info for sampling this texture, for writing into a shared material set
+		*/
+		vk::DescriptorImageInfo GetImageDescriptor() const;
 		~Texture();
 	private:
 		int m_width;
@@ -33,6 +38,7 @@ namespace vkImage
 
 		vk::CommandBuffer m_commandBuffer;
 		vk::Queue m_queue;
+		std::mutex* m_uploadMutex;
 
 		void Load();
 
@@ -0,0 +1,124 @@
+#include "Transforms.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define TRANSFORMS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORMS_SSE
+#endif
+
+namespace
+{
+	/**
+		Quantize two components to snorm16 and pack them, first in the low half.
+		Rounds to nearest even like the SIMD conversions in PackInstances, so both paths produce the same bits.
+		glm::packSnorm2x16 rounds halves away from zero instead.
+	*/
+	uint32_t PackSnorm16Pair(float low, float high)
+	{
+		int32_t lowBits = static_cast<int32_t>(std::nearbyint(std::clamp(low, -1.0f, 1.0f) * 32767.0f));
+		int32_t highBits = static_cast<int32_t>(std::nearbyint(std::clamp(high, -1.0f, 1.0f) * 32767.0f));
+		return (static_cast<uint32_t>(lowBits) & 0xFFFF) | (static_cast<uint32_t>(highBits) << 16);
+	}
+
+#if defined(TRANSFORMS_AVX) || defined(TRANSFORMS_SSE)
+	/**
+		Write a lane group's records, combining the quantized rotation components in pairs.
+
+		\param rotation the snorm16 rotation components by lane, x y z w
+		\param positions the translation of each lane
+		\param scales the scale of each lane
+		\param instances receives Lanes records
+	*/
+	template <uint32_t Lanes>
+	void StoreInstances(const int32_t (&rotation)[4][Lanes], const glm::vec3* positions, const glm::vec3* scales, vkUtil::InstanceData* instances)
+	{
+		for (uint32_t lane = 0; lane < Lanes; ++lane)
+		{
+			vkUtil::InstanceData instance;
+			instance.m_position = positions[lane];
+			instance.m_rotationXY = (static_cast<uint32_t>(rotation[0][lane]) & 0xFFFF) | (static_cast<uint32_t>(rotation[1][lane]) << 16);
+			instance.m_scale = scales[lane];
+			instance.m_rotationZW = (static_cast<uint32_t>(rotation[2][lane]) & 0xFFFF) | (static_cast<uint32_t>(rotation[3][lane]) << 16);
+			instances[lane] = instance;
+		}
+	}
+#endif
+}
+
+vkUtil::InstanceData vkUtil::PackInstance(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	//Same packing as unpackSnorm2x16 in expand.comp undoes
+	InstanceData instance;
+	instance.m_position = position;
+	instance.m_rotationXY = PackSnorm16Pair(rotation.x, rotation.y);
+	instance.m_scale = scale;
+	instance.m_rotationZW = PackSnorm16Pair(rotation.z, rotation.w);
+	return instance;
+}
+
+void vkUtil::PackInstances(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, uint32_t count, InstanceData* instances)
+{
+	uint32_t i = 0;
+
+#if defined(TRANSFORMS_AVX)
+	const __m256 snormMax = _mm256_set1_ps(32767.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 minusOne = _mm256_set1_ps(-1.0f);
+
+	alignas(32) float components[4][8];
+	alignas(32) int32_t rotation[4][8];
+	for (; i + 8 <= count; i += 8)
+	{
+		//Rotations are stored AoS, transpose into lanes
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			components[0][lane] = rotations[i + lane].x;
+			components[1][lane] = rotations[i + lane].y;
+			components[2][lane] = rotations[i + lane].z;
+			components[3][lane] = rotations[i + lane].w;
+		}
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			__m256 component = _mm256_max_ps(minusOne, _mm256_min_ps(one, _mm256_load_ps(components[c])));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(rotation[c]), _mm256_cvtps_epi32(_mm256_mul_ps(component, snormMax)));
+		}
+
+		StoreInstances(rotation, positions + i, scales + i, instances + i);
+	}
+#elif defined(TRANSFORMS_SSE)
+	const __m128 snormMax = _mm_set1_ps(32767.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+
+	alignas(16) float components[4][4];
+	alignas(16) int32_t rotation[4][4];
+	for (; i + 4 <= count; i += 4)
+	{
+		//Rotations are stored AoS, transpose into lanes
+		for (uint32_t lane = 0; lane < 4; ++lane)
+		{
+			components[0][lane] = rotations[i + lane].x;
+			components[1][lane] = rotations[i + lane].y;
+			components[2][lane] = rotations[i + lane].z;
+			components[3][lane] = rotations[i + lane].w;
+		}
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			__m128 component = _mm_max_ps(minusOne, _mm_min_ps(one, _mm_load_ps(components[c])));
+			_mm_store_si128(reinterpret_cast<__m128i*>(rotation[c]), _mm_cvtps_epi32(_mm_mul_ps(component, snormMax)));
+		}
+
+		StoreInstances(rotation, positions + i, scales + i, instances + i);
+	}
+#endif
+
+	//Scalar tail (or the whole batch without SIMD support)
+	for (; i < count; ++i)
+	{
+		instances[i] = PackInstance(positions[i], rotations[i], scales[i]);
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Config.h"
+#include "RenderStructs.h"
+
+namespace vkUtil
+{
+	/**
+		Pack an instance's transform into its compact GPU record.
+
+		\param position world space translation
+		\param rotation orientation, must be normalized
+		\param scale per axis scale
+		\returns the record expand.comp turns into translate * rotate * scale
+	*/
+	InstanceData PackInstance(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	/**
+		Pack a batch of instances, quantizing several rotations per SIMD lane group
+		(8 with AVX, 4 with SSE, scalar otherwise). Every record is written exactly once
+		and in order, so the destination may be write combined mapped memory.
+
+		\param positions world space translation of each instance
+		\param rotations normalized orientation of each instance
+		\param scales per axis scale of each instance
+		\param count the number of instances
+		\param instances receives the records, must hold count entries
+	*/
+	void PackInstances(const glm::vec3* positions, const glm::quat* rotations, const glm::vec3* scales, uint32_t count, InstanceData* instances);
+}
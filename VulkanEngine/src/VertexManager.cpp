@@ -1,10 +1,11 @@
 #include "VertexManager.h"
+#include "CpuProfiler.h"
 
 VertexManager::VertexManager() : m_indexOffset{ 0 }
 {
 }
 
-void VertexManager::Consume(MeshTypes type, std::vector<float>& vertexData, std::vector<uint32_t>& indexData) 
+void VertexManager::Consume(MeshTypes type, std::vector<float>& vertexData, std::vector<uint32_t>& indexData, const vkUtil::MeshBounds& bounds) 
 {
 	int vertexCount = static_cast<int>(vertexData.size() / 11);
 	int indexCount = static_cast<int>(indexData.size());
@@ -12,6 +13,7 @@ void VertexManager::Consume(MeshTypes type, std::vector<float>& vertexData, std:
 
 	m_firstIndices.insert(std::make_pair(type, lastIndex));
 	m_indexCounts.insert(std::make_pair(type, indexCount));
+	m_bounds.insert(std::make_pair(type, bounds));
 
 	for (float attribute : vertexData)
 	{
@@ -28,65 +30,63 @@ void VertexManager::Consume(MeshTypes type, std::vector<float>& vertexData, std:
 
 void VertexManager::Finalize(const FinalizationChunk& finalizationChunk)
 {
+	vkUtil::CpuZone zone("Upload meshes");
+
 	m_logicalDevice = finalizationChunk.m_logicalDevice;
 
-	// Make a staging buffer for vertices
+	m_vertexBuffer = Upload(m_vertexLump.data(), sizeof(float) * m_vertexLump.size(), vk::BufferUsageFlagBits::eVertexBuffer, finalizationChunk);
+	m_indexBuffer = Upload(m_indexLump.data(), sizeof(uint32_t) * m_indexLump.size(), vk::BufferUsageFlagBits::eIndexBuffer, finalizationChunk);
+
+	// Mesh types double as indices into the bounds array
+	std::vector<glm::vec4> spheres(m_bounds.size(), glm::vec4(0.f));
+	for (const auto& [type, bounds] : m_bounds)
+	{
+		spheres[static_cast<size_t>(type)] = glm::vec4(bounds.m_center, bounds.m_radius);
+	}
+	m_boundsBuffer = Upload(spheres.data(), sizeof(glm::vec4) * spheres.size(), vk::BufferUsageFlagBits::eStorageBuffer, finalizationChunk);
+
+	m_vertexLump.clear();
+}
+
+Buffer VertexManager::Upload(const void* data, size_t size, vk::BufferUsageFlags usage, const FinalizationChunk& finalizationChunk)
+{
+	// Make a staging buffer
 	BufferInputChunk inputChunk;
 	inputChunk.m_logicalDevice = finalizationChunk.m_logicalDevice;
 	inputChunk.m_physicalDevice = finalizationChunk.m_physicalDevice;
-	inputChunk.m_size = sizeof(float) * m_vertexLump.size();
+	inputChunk.m_size = size;
 	inputChunk.m_usage = vk::BufferUsageFlagBits::eTransferSrc;
 	inputChunk.m_memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
 	Buffer stagingBuffer = vkUtil::CreateBuffer(inputChunk);
 
-	// Fill it with vertex data
+	// Fill it with data
 	void* memoryLocation = m_logicalDevice.mapMemory(stagingBuffer.m_bufferMemory, 0, inputChunk.m_size);
-	memcpy(memoryLocation, m_vertexLump.data(), inputChunk.m_size);
+	memcpy(memoryLocation, data, inputChunk.m_size);
 	m_logicalDevice.unmapMemory(stagingBuffer.m_bufferMemory);
 
-	// Make the vertex buffer
-	inputChunk.m_usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer;
+	// Make the device local buffer
+	inputChunk.m_usage = vk::BufferUsageFlagBits::eTransferDst | usage;
 	inputChunk.m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
-	m_vertexBuffer = vkUtil::CreateBuffer(inputChunk);
+	Buffer buffer = vkUtil::CreateBuffer(inputChunk);
 
 	// Fill it
-	vkUtil::CopyBuffer(stagingBuffer, m_vertexBuffer, inputChunk.m_size, finalizationChunk.m_queue, finalizationChunk.m_commandBuffer);
+	vkUtil::CopyBuffer(stagingBuffer, buffer, inputChunk.m_size, finalizationChunk.m_queue, finalizationChunk.m_commandBuffer);
 
 	// Destroy the staging buffer
 	m_logicalDevice.destroyBuffer(stagingBuffer.m_buffer);
-	m_logicalDevice.freeMemory(stagingBuffer.m_bufferMemory);
-
-	// Make a staging buffer for indices
-	inputChunk.m_size = sizeof(uint32_t) * m_indexLump.size();
-	inputChunk.m_usage = vk::BufferUsageFlagBits::eTransferSrc;
-	inputChunk.m_memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
-	stagingBuffer = vkUtil::CreateBuffer(inputChunk);
+	vkUtil::FreeMemory(m_logicalDevice, stagingBuffer.m_bufferMemory);
 
-	// Fill it with index data
-	memoryLocation = m_logicalDevice.mapMemory(stagingBuffer.m_bufferMemory, 0, inputChunk.m_size);
-	memcpy(memoryLocation, m_indexLump.data(), inputChunk.m_size);
-	m_logicalDevice.unmapMemory(stagingBuffer.m_bufferMemory);
-
-	// Make the index buffer
-	inputChunk.m_usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer;
-	inputChunk.m_memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
-	m_indexBuffer = vkUtil::CreateBuffer(inputChunk);
-
-	// Fill it
-	vkUtil::CopyBuffer(stagingBuffer, m_indexBuffer, inputChunk.m_size, finalizationChunk.m_queue, finalizationChunk.m_commandBuffer);
-
-	// Destroy the staging buffer
-	m_logicalDevice.destroyBuffer(stagingBuffer.m_buffer);
-	m_logicalDevice.freeMemory(stagingBuffer.m_bufferMemory);
-
-	m_vertexLump.clear();
+	return buffer;
 }
 
 VertexManager::~VertexManager() 
 {
 	m_logicalDevice.destroyBuffer(m_vertexBuffer.m_buffer);
-	m_logicalDevice.freeMemory(m_vertexBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(m_logicalDevice, m_vertexBuffer.m_bufferMemory);
 
 	m_logicalDevice.destroyBuffer(m_indexBuffer.m_buffer);
-	m_logicalDevice.freeMemory(m_indexBuffer.m_bufferMemory);
+	vkUtil::FreeMemory(m_logicalDevice, m_indexBuffer.m_bufferMemory);
+
+	m_logicalDevice.destroyBuffer(m_boundsBuffer.m_buffer);
+	vkUtil::FreeMemory(m_logicalDevice, m_boundsBuffer.m_bufferMemory);
 }
\ No newline at end of file
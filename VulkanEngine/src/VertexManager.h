@@ -1,6 +1,7 @@
 #pragma once
 #include "Config.h"
 #include "Memory.h"
+#include "RenderStructs.h"
 
 struct FinalizationChunk
 {
@@ -15,14 +16,28 @@ class VertexManager
 public:
 	VertexManager();
 	~VertexManager();
-	void Consume(MeshTypes type, std::vector<float>& vertexData, std::vector<uint32_t>& indexData);
+	void Consume(MeshTypes type, std::vector<float>& vertexData, std::vector<uint32_t>& indexData, const vkUtil::MeshBounds& bounds);
 	void Finalize(const FinalizationChunk& finalizationChunk);
 	Buffer m_vertexBuffer, m_indexBuffer;
+	// Bounding sphere (center, radius) of each mesh, indexed by MeshTypes, for GPU culling
+	Buffer m_boundsBuffer;
 	std::unordered_map<MeshTypes, int> m_firstIndices;
 	std::unordered_map<MeshTypes, int> m_indexCounts;
+	std::unordered_map<MeshTypes, vkUtil::MeshBounds> m_bounds;
 private:
 	int m_indexOffset;
 	vk::Device m_logicalDevice;
 	std::vector<float> m_vertexLump;
 	std::vector<uint32_t> m_indexLump;
+
+	/**
+		Upload data to a new device local buffer through a staging buffer.
+
+		\param data the data to upload
+		\param size the size (in bytes) of the data
+		\param usage how the buffer will be used, transfer destination is added
+		\param finalizationChunk the device, queue and command buffer to use
+		\returns the filled device local buffer
+	*/
+	Buffer Upload(const void* data, size_t size, vk::BufferUsageFlags usage, const FinalizationChunk& finalizationChunk);
 };
\ No newline at end of file
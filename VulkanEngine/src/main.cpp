@@ -1,8 +1,105 @@
 #include "Application.h"
+#include "CpuProfiler.h"
 
-int main() 
+int main(int argc, char** argv) 
 {
-	Application app{ 1280, 720 };
-	app.Run();
+	std::vector<std::string> arguments(argv + 1, argv + argc);
+
+	//--trace <trace.json> records CPU zones on every thread, written on exit for chrome://tracing
+	std::string traceFilename;
+	auto trace = std::find(arguments.begin(), arguments.end(), "--trace");
+	if (trace != arguments.end() && trace + 1 != arguments.end())
+	{
+		traceFilename = *(trace + 1);
+		arguments.erase(trace, trace + 2);
+
+		vkUtil::CpuProfiler::Get().SetEnabled(true);
+		vkUtil::CpuProfiler::Get().SetThreadName("Main");
+	}
+
+	//--frame-stats <stats.csv|stats.json> saves the timings of recent frames on exit
+	std::string frameStatsFilename;
+	auto frameStats = std::find(arguments.begin(), arguments.end(), "--frame-stats");
+	if (frameStats != arguments.end() && frameStats + 1 != arguments.end())
+	{
+		frameStatsFilename = *(frameStats + 1);
+		arguments.erase(frameStats, frameStats + 2);
+	}
+
+	//--capture <session.bin> records the session's scene changes, camera and size for --replay
+	std::string captureFilename;
+	auto capture = std::find(arguments.begin(), arguments.end(), "--capture");
+	if (capture != arguments.end() && capture + 1 != arguments.end())
+	{
+		captureFilename = *(capture + 1);
+		arguments.erase(capture, capture + 2);
+	}
+
+	bool windowed = std::find(arguments.begin(), arguments.end(), "--windowed") != arguments.end();
+
+	//--cpu-culling culls on job threads and writes the indirect draws from the CPU, instead of in a compute pass
+	bool gpuCulling = true;
+	auto cpuCulling = std::find(arguments.begin(), arguments.end(), "--cpu-culling");
+	if (cpuCulling != arguments.end())
+	{
+		gpuCulling = false;
+		arguments.erase(cpuCulling);
+	}
+
+	//Interactive by default, every other mode renders headless unless --windowed is given
+	bool headless = false;
+	std::function<void(Application&)> run = [](Application& app) { app.Run(); };
+
+	//--benchmark <grid|random|clustered> <instances per mesh> <frames> [summary.json] renders a stress scene
+	if (arguments.size() >= 4 && arguments[0] == "--benchmark")
+	{
+		std::optional<SceneLayout> layout = ParseSceneLayout(arguments[1]);
+		if (!layout)
+		{
+			std::cout << "Unknown scene layout \"" << arguments[1] << "\", expected grid, random or clustered" << std::endl;
+			return 1;
+		}
+
+		BenchmarkSettings settings;
+		settings.m_layout = *layout;
+		settings.m_instancesPerMesh = static_cast<uint32_t>(std::stoul(arguments[2]));
+		settings.m_frameCount = static_cast<uint32_t>(std::stoul(arguments[3]));
+		if (arguments.size() >= 5 && arguments[4] != "--windowed")
+			settings.m_summaryFilename = arguments[4];
+
+		headless = !windowed;
+		run = [settings](Application& app) { app.RunBenchmark(settings); };
+	}
+	//--replay <session.bin> plays a capture back uncapped
+	else if (arguments.size() >= 2 && arguments[0] == "--replay")
+	{
+		headless = !windowed;
+		run = [filename = arguments[1]](Application& app) { app.Replay(filename); };
+	}
+	//--headless <frames> [output.ppm] renders offscreen without a window, for benchmark hosts
+	else if (arguments.size() >= 2 && arguments[0] == "--headless")
+	{
+		uint32_t frameCount = static_cast<uint32_t>(std::stoul(arguments[1]));
+		std::string imageFilename = arguments.size() >= 3 ? arguments[2] : "frame.ppm";
+
+		headless = true;
+		run = [frameCount, imageFilename](Application& app) { app.RunFrames(frameCount, imageFilename.c_str()); };
+	}
+
+	//Scoped, so shutdown is done and traced before the trace is written
+	{
+		Application app{ 1280, 720, headless, gpuCulling };
+		if (!captureFilename.empty())
+			app.StartCapture(captureFilename);
+
+		run(app);
+
+		if (!frameStatsFilename.empty())
+			app.SaveFrameStats(frameStatsFilename);
+	}
+
+	if (!traceFilename.empty())
+		vkUtil::CpuProfiler::Get().WriteChromeTrace(traceFilename.c_str());
+
 	return 0;
 }
\ No newline at end of file